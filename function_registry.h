@@ -47,6 +47,7 @@
 #define FUNCTION_REGISTRY
 
 #include <unordered_map>
+#include <string>
 using std::string;
 #include <functional>
 using std::function;
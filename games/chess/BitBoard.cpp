@@ -1,4 +1,14 @@
 #include "BitBoard.h"
 
-// TODO:
-
+std::ostream& operator<<(std::ostream& out, const BitBoard& board)
+{
+    for (int rank = 0; rank < 8; ++rank)
+    {
+        for (int file = 0; file < 8; ++file)
+        {
+            out << (board.at(rank * 8 + file) ? 'x' : '.') << " ";
+        }
+        out << std::endl;
+    }
+    return out;
+}
@@ -2,16 +2,116 @@
 
 // A wrapper around a 64-bit integer that allows fast operations commonly
 //  found in chess.
+// Bit n represents the square at rank n / 8 and file n % 8, which is the
+//  same orientation as Skaia::Position (rank 0 is Black's home row).
 
 #include <cstdint>
+#include <iostream>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 class BitBoard
 {
     public:
         uint64_t data;
 
-        BitBoard();
+        constexpr BitBoard() : data(0) {}
+        constexpr BitBoard(uint64_t data) : data(data) {}
+
+        // Masks for whole ranks and files
+        static constexpr BitBoard rank_mask(int rank) { return BitBoard(0xffull << (rank * 8)); }
+        static constexpr BitBoard file_mask(int file) { return BitBoard(0x0101010101010101ull << file); }
+        static constexpr BitBoard square(int n) { return BitBoard(1ull << n); }
+
+        bool at(int n) const { return (data >> n) & 1; }
+        void set(int n) { data |= 1ull << n; }
+        void reset(int n) { data &= ~(1ull << n); }
+
+        bool any() const { return data != 0; }
+        bool none() const { return data == 0; }
+        bool several() const { return (data & (data - 1)) != 0; } // More than one bit is set
+        explicit operator bool() const { return data != 0; }
+
+        // Number of set bits
+        int count() const
+        {
+#ifdef _MSC_VER
+            return static_cast<int>(__popcnt64(data));
+#else
+            return __builtin_popcountll(data);
+#endif
+        }
+
+        // Index of the lowest/highest set bit, undefined when none() is true
+        int lsb() const
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward64(&index, data);
+            return static_cast<int>(index);
+#else
+            return __builtin_ctzll(data);
+#endif
+        }
+        int msb() const
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanReverse64(&index, data);
+            return static_cast<int>(index);
+#else
+            return 63 - __builtin_clzll(data);
+#endif
+        }
+
+        // Returns the index of the lowest set bit and clears it
+        int pop_lsb()
+        {
+            int n = lsb();
+            data &= data - 1;
+            return n;
+        }
+
+        // Moves every set square by the given delta, dropping squares that
+        //  would fall off the board instead of wrapping around to another rank.
+        BitBoard shifted(int rank_delta, int file_delta) const
+        {
+            uint64_t source = data;
+            for (int file = 0; file < 8; ++file)
+            {
+                if (file + file_delta < 0 || file + file_delta >= 8) source &= ~file_mask(file).data;
+            }
+            int shift = rank_delta * 8 + file_delta;
+            return BitBoard(shift >= 0 ? source << shift : source >> -shift);
+        }
+
+        BitBoard operator&(const BitBoard& rhs) const { return BitBoard(data & rhs.data); }
+        BitBoard operator|(const BitBoard& rhs) const { return BitBoard(data | rhs.data); }
+        BitBoard operator^(const BitBoard& rhs) const { return BitBoard(data ^ rhs.data); }
+        BitBoard operator~() const { return BitBoard(~data); }
+        BitBoard operator<<(int n) const { return BitBoard(data << n); }
+        BitBoard operator>>(int n) const { return BitBoard(data >> n); }
+        BitBoard& operator&=(const BitBoard& rhs) { data &= rhs.data; return *this; }
+        BitBoard& operator|=(const BitBoard& rhs) { data |= rhs.data; return *this; }
+        BitBoard& operator^=(const BitBoard& rhs) { data ^= rhs.data; return *this; }
+        bool operator==(const BitBoard& rhs) const { return data == rhs.data; }
+        bool operator!=(const BitBoard& rhs) const { return data != rhs.data; }
 
-        bool at(int n) const;
+        // Allows iterating over the indices of the set bits, lowest first:
+        //  for (int square : board) { ... }
+        class iterator
+        {
+            public:
+                uint64_t data;
+                iterator(uint64_t data) : data(data) {}
+                int operator*() const { return BitBoard(data).lsb(); }
+                iterator& operator++() { data &= data - 1; return *this; }
+                bool operator!=(const iterator& rhs) const { return data != rhs.data; }
+        };
+        iterator begin() const { return iterator(data); }
+        iterator end() const { return iterator(0); }
 };
 
+std::ostream& operator<<(std::ostream& out, const BitBoard& board);
@@ -1,65 +1,40 @@
 #include "HistoryTable.h"
 
-#include <random>
-
-void HistoryTable::increase(const Skaia::Action &action, int amount, int turn)
+void HistoryTable::decay()
 {
-    if (scores.count(action) > 0)
-    {
-        scores[action].first += amount;
-        scores[action].second = turn;
-    }
-    else
+    for (auto& from : scores)
     {
-        scores.emplace(action, std::make_pair(amount, turn));
+        for (auto& to : from)
+        {
+            for (auto& score : to)
+            {
+                score /= 2;
+            }
+        }
     }
 }
 
-int HistoryTable::get_score(const Skaia::Action &action)
+void HistoryTable::clear()
 {
-    if (scores.count(action) > 0)
-    {
-        return scores[action].first;
-    }
-    else
-    {
-        return 0;
-    }
+    scores = {};
 }
 
-void HistoryTable::decay(int number_to_check, int threshold)
+std::ostream& operator<<(std::ostream& out, const HistoryTable& ht)
 {
-    static auto rand = std::default_random_engine(0);
-
-    for (int i = 0; i < number_to_check; ++i)
+    for (auto color : {Skaia::White, Skaia::Black})
     {
-        // Stop if their aint none left
-        if (scores.size() == 0) break;
-        // Choose a random non-empty bucket
-        int bucket, bucket_size;
-        do
-        { 
-            bucket = std::uniform_int_distribution<int>(0, scores.bucket_count() - 1)(rand);
-        }
-        while ( (bucket_size = scores.bucket_size(bucket)) == 0 );
-
-        // Select a random element from the bucket
-        const auto &key_value = std::next(scores.cbegin(bucket),
-                std::uniform_int_distribution<int>(0, bucket_size - 1)(rand));
-        if (key_value->second.second < threshold)
+        for (int from = 0; from < 64; ++from)
         {
-            // Remove the element
-            scores.erase(key_value->first);
+            for (int to = 0; to < 64; ++to)
+            {
+                int score = ht.scores[color][from][to];
+                if (score != 0)
+                {
+                    out << color << " " << Skaia::Position::from_square(from) << " to " <<
+                        Skaia::Position::from_square(to) << ": " << score << std::endl;
+                }
+            }
         }
     }
-}
-
-std::ostream& operator<<(std::ostream& out, const HistoryTable& ht)
-{
-    for (auto& key_value : ht.scores)
-    {
-        out << key_value.first << ": " << key_value.second.first << ", " << key_value.second.second << std::endl;
-    }
     return out;
 }
-
@@ -1,34 +1,44 @@
-/// Stores a "score" and "age" for Skaia::Action's so that
+/// Stores a "score" for Skaia::Action's so that
 ///  pruning can be done better by ordering actions by their
 ///  score in this table.
+/// Scores are kept in a flat table indexed by the color moving and the
+///  squares moved from and to, so lookups are just an array access.
+/// Promotions to different types share the same score.
 
 #pragma once
 
 #include "SkaiaAction.h"
 
-#include <unordered_map>
+#include <array>
+#include <iostream>
 
 class HistoryTable
 {
     public:
-        // First of pair is score
-        // Second of pair is the turn it was updated on
-        std::unordered_map<Skaia::Action, std::pair<int, int>> scores;
+        // [color][from][to]
+        std::array<std::array<std::array<int, 64>, 64>, 2> scores;
 
-        HistoryTable() = default;
+        HistoryTable() : scores() {}
         HistoryTable(const HistoryTable &other) = default;
         HistoryTable& operator=(const HistoryTable &other) = default;
 
-        // Increases an action's score and sets the turn it was updated on
-        void increase(const Skaia::Action &action, int amount, int turn);
+        // Increases an action's score
+        void increase(Skaia::Color color, const Skaia::Action &action, int amount)
+        {
+            scores[color][action.from_square()][action.to_square()] += amount;
+        }
 
-        // Returns the score for the given action, zero if not found
-        int get_score(const Skaia::Action &action);
+        // Returns the score for the given action, zero if it was never increased
+        int get_score(Skaia::Color color, const Skaia::Action &action) const
+        {
+            return scores[color][action.from_square()][action.to_square()];
+        }
 
-        // Looks at `number_to_check` entries and if their turns are earlier
-        //  than `threshold` then they are removed from the table.
-        void decay(int number_to_check, int threshold);
+        // Halves every score, so that actions which were good many turns
+        //  ago give way to the ones that are good now
+        void decay();
+
+        void clear();
 };
 
 std::ostream& operator<<(std::ostream& out, const HistoryTable& ht);
-
@@ -50,9 +50,9 @@ namespace Skaia
         bool operator==(const Position& rhs) const { return rank == rhs.rank && file == rhs.file; }
         bool operator!=(const Position& rhs) const { return rank != rhs.rank || file != rhs.file; }
         bool operator<(const Position& rhs) const { return rank < rhs.rank || (rank == rhs.rank && file < rhs.file); }
-        Position& operator+=(const Position& rhs) { rank += rhs.rank; file += rhs.file; }
-        Position& operator-=(const Position& rhs) { rank -= rhs.rank; file -= rhs.file; }
-        Position& operator*=(int factor) { rank *= factor; file *= factor; }
+        Position& operator+=(const Position& rhs) { rank += rhs.rank; file += rhs.file; return *this; }
+        Position& operator-=(const Position& rhs) { rank -= rhs.rank; file -= rhs.file; return *this; }
+        Position& operator*=(int factor) { rank *= factor; file *= factor; return *this; }
         Position operator+(const Position& rhs) const
         {
             Position new_pos(*this);
@@ -71,6 +71,9 @@ namespace Skaia
             new_pos *= factor;
             return new_pos;
         }
+        // Convert to/from an index into a BitBoard
+        int square() const { return rank * 8 + file; }
+        static Position from_square(int square) { return Position(square / 8, square % 8); }
         Position direction_to(const Position& to) const
         {
             Position delta = to - *this;
@@ -2,6 +2,6 @@
 
 std::ostream& operator<<(std::ostream& out, const Skaia::Action& action)
 {
-    return out << "Act(" << action.from << " to " << action.to << " (" << Skaia::type_from_skaia(action.promotion) << "))";
+    return out << "Act(" << action.from() << " to " << action.to() << " (" << Skaia::type_from_skaia(action.promotion()) << "))";
 }
 
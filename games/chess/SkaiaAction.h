@@ -1,53 +1,51 @@
 #pragma once
 
-#include <bitset>
-#include <vector>
-#include <string>
+#include <cstdint>
+#include <functional>
+#include <iostream>
 
 #include "Skaia.h"
 
 namespace Skaia
 {
+    // An action packed into 16 bits. The low 6 bits are the square moved from,
+    //  the next 6 the square moved to, and the top 4 the promotion Type.
+    // The promotion also flags special moves: Pawn for a pawn moving
+    //  forward twice, and King for castling (when the actor is a king)
+    //  or en passant (when the actor is a pawn).
     class Action
     {
         public:
-            Position from, to;
-            Type promotion;
+            uint16_t data;
 
+            // The null action, from a8 to a8, which no piece can make
+            Action() : data(0) {}
+            Action(int from, int to, Type promotion) :
+                data(static_cast<uint16_t>(from | to << 6 | static_cast<int>(promotion) << 12)) {}
             Action(const Position& from, const Position& to, Type promotion) :
-                from(from), to(to), promotion(promotion) {}
-
-            bool operator==(const Action& rhs) const
-            {
-                return from == rhs.from && to == rhs.to && promotion == rhs.promotion;
-            }
-            bool operator!=(const Action& rhs) const
-            {
-                return from != rhs.from && to != rhs.to && promotion != rhs.promotion;
-            }
-            bool operator<(const Action& rhs) const
-            {
-                return (from < rhs.from || (from == rhs.from &&
-                        to < rhs.to || (to == rhs.to &&
-                        promotion < rhs.promotion)));
-            }
+                Action(from.square(), to.square(), promotion) {}
+
+            int from_square() const { return data & 0x3f; }
+            int to_square() const { return (data >> 6) & 0x3f; }
+            Position from() const { return Position::from_square(from_square()); }
+            Position to() const { return Position::from_square(to_square()); }
+            Type promotion() const { return static_cast<Type>(data >> 12); }
+
+            bool operator==(const Action& rhs) const { return data == rhs.data; }
+            bool operator!=(const Action& rhs) const { return data != rhs.data; }
+            bool operator<(const Action& rhs) const { return data < rhs.data; }
     };
+    static_assert(sizeof(Action) == 2, "Action should pack into 16 bits");
 }
 
 std::ostream& operator<<(std::ostream& out, const Skaia::Action& action);
 
-// From: http://en.cppreference.com/w/cpp/utility/hash
 namespace std
 {
     template<> struct hash<Skaia::Action> {
         size_t operator() (const Skaia::Action &a) const
         {
-            return std::hash<int>()(a.from.rank) ^
-                (std::hash<int>()(a.from.file) << 1) ^
-                (std::hash<int>()(a.to.rank) << 2) ^
-                (std::hash<int>()(a.to.file) << 3) ^
-                (std::hash<int>()(static_cast<int>(a.promotion)) << 4);
+            return std::hash<uint16_t>()(a.data);
         }
     };
 }
-
@@ -0,0 +1,182 @@
+#include "SkaiaAttacks.h"
+
+#include <vector>
+
+namespace Skaia
+{
+    namespace Attacks
+    {
+        std::array<std::array<BitBoard, 64>, 2> pawn_table;
+        std::array<BitBoard, 64> knight_table;
+        std::array<BitBoard, 64> king_table;
+        std::array<std::array<BitBoard, 64>, 8> ray_table;
+        std::array<std::array<BitBoard, 64>, 64> between_table;
+        std::array<std::array<BitBoard, 64>, 64> line_table;
+        std::array<Magic, 64> bishop_magics;
+        std::array<Magic, 64> rook_magics;
+        // Shared storage that every square's Magic::attacks points into
+        std::array<BitBoard, 0x1480> bishop_attacks;
+        std::array<BitBoard, 0x19000> rook_attacks;
+
+        namespace
+        {
+            // Sets the bit for pos + delta if it is still on the board
+            void add(BitBoard& board, const Position& pos, const Position& delta)
+            {
+                Position to = pos + delta;
+                if (0 <= to.rank && to.rank < 8 && 0 <= to.file && to.file < 8)
+                {
+                    board.set(to.square());
+                }
+            }
+
+            // xorshift64*, much cheaper than std::mt19937_64 to seed and step
+            struct XorShift
+            {
+                uint64_t state;
+                XorShift(uint64_t seed) : state(seed) {}
+                uint64_t operator()()
+                {
+                    state ^= state >> 12;
+                    state ^= state << 25;
+                    state ^= state >> 27;
+                    return state * 2685821657736338717ull;
+                }
+            };
+
+            BitBoard slide(const std::array<int, 4>& directions, int square, BitBoard occupied)
+            {
+                BitBoard attacks;
+                for (int direction : directions)
+                {
+                    attacks |= ray(direction, square, occupied);
+                }
+                return attacks;
+            }
+
+            // Fills in the magics and attack table slices for one type of slider.
+            // Candidate magics are sparse random numbers, and a candidate is
+            //  accepted once it maps every blocker arrangement to a slot that
+            //  holds the right attack set.
+            // The search for each square starts again from a seed for its rank,
+            //  these seeds happen to find every magic quickly.
+            void init_magics(const std::array<int, 4>& directions, std::array<Magic, 64>& magics, BitBoard* table)
+            {
+                std::vector<BitBoard> occupancy(4096), reference(4096);
+                std::vector<int> epoch(4096, 0);
+                int attempt = 0;
+                BitBoard* attacks = table;
+                for (int square = 0; square < 64; ++square)
+                {
+                    Position pos = Position::from_square(square);
+                    BitBoard edges =
+                        ((BitBoard::rank_mask(0) | BitBoard::rank_mask(7)) & ~BitBoard::rank_mask(pos.rank)) |
+                        ((BitBoard::file_mask(0) | BitBoard::file_mask(7)) & ~BitBoard::file_mask(pos.file));
+                    Magic& m = magics[square];
+                    m.mask = slide(directions, square, BitBoard()) & ~edges;
+                    m.shift = 64 - m.mask.count();
+                    m.attacks = attacks;
+
+                    // Enumerate every subset of the mask (Carry-Rippler) along with its attacks
+                    int size = 0;
+                    BitBoard subset;
+                    do
+                    {
+                        occupancy[size] = subset;
+                        reference[size] = slide(directions, square, subset);
+#ifdef SKAIA_USE_PEXT
+                        m.attacks[m.index(subset)] = reference[size];
+#endif
+                        size += 1;
+                        subset = BitBoard((subset.data - m.mask.data) & m.mask.data);
+                    }
+                    while (subset.any());
+                    attacks += size;
+
+#ifndef SKAIA_USE_PEXT
+                    const std::array<uint64_t, 8> seeds{{728, 10316, 55013, 32803, 12281, 15100, 16645, 255}};
+                    XorShift random(seeds[pos.rank]);
+                    for (int i = 0; i < size; )
+                    {
+                        do
+                        {
+                            m.magic = random() & random() & random();
+                        }
+                        while (BitBoard((m.magic * m.mask.data) >> 56).count() < 6);
+
+                        // epoch[] marks which slots were written during this attempt
+                        attempt += 1;
+                        for (i = 0; i < size; ++i)
+                        {
+                            unsigned index = m.index(occupancy[i]);
+                            if (epoch[index] < attempt)
+                            {
+                                epoch[index] = attempt;
+                                m.attacks[index] = reference[i];
+                            }
+                            else if (m.attacks[index] != reference[i])
+                            {
+                                break;
+                            }
+                        }
+                    }
+#endif
+                }
+            }
+
+            struct Initializer
+            {
+                Initializer()
+                {
+                    for (int square = 0; square < 64; ++square)
+                    {
+                        Position pos = Position::from_square(square);
+                        // Pawns, white moves towards rank 0 and black towards rank 7
+                        add(pawn_table[White][square], pos, Position(-1, -1));
+                        add(pawn_table[White][square], pos, Position(-1, 1));
+                        add(pawn_table[Black][square], pos, Position(1, -1));
+                        add(pawn_table[Black][square], pos, Position(1, 1));
+                        for (auto& delta : std::array<Position, 8>{{
+                                {-2, 1}, {-1, 2}, {1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}}})
+                        {
+                            add(knight_table[square], pos, delta);
+                        }
+                        for (auto& delta : directions)
+                        {
+                            add(king_table[square], pos, delta);
+                        }
+                        // Rays stop at the edge of the board
+                        for (int direction = 0; direction < 8; ++direction)
+                        {
+                            Position to = pos;
+                            while (true)
+                            {
+                                to += directions[direction];
+                                if (to.rank < 0 || to.rank >= 8 || to.file < 0 || to.file >= 8) break;
+                                ray_table[direction][square].set(to.square());
+                            }
+                        }
+                    }
+                    // Lines and the squares between are made by joining rays
+                    for (int from = 0; from < 64; ++from)
+                    {
+                        for (int direction = 0; direction < 8; ++direction)
+                        {
+                            int opposite = (direction + 4) % 8;
+                            BitBoard line = ray_table[direction][from] | ray_table[opposite][from] | BitBoard::square(from);
+                            for (int to : ray_table[direction][from])
+                            {
+                                between_table[from][to] = ray_table[direction][from] & ray_table[opposite][to];
+                                line_table[from][to] = line;
+                            }
+                        }
+                    }
+                    // The sliding tables are built from the rays
+                    init_magics({{1, 3, 5, 7}}, bishop_magics, bishop_attacks.data());
+                    init_magics({{0, 2, 4, 6}}, rook_magics, rook_attacks.data());
+                }
+            };
+            Initializer initializer;
+        }
+    }
+}
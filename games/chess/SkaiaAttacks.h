@@ -0,0 +1,115 @@
+#pragma once
+
+// Precomputed attack sets for every type of piece on every square.
+// Attack sets for sliding pieces depend on which squares are occupied, they
+//  include every square along a ray up to and including the first blocker,
+//  whether that blocker is a friend or a foe.
+
+#include <array>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#define SKAIA_USE_PEXT
+#endif
+
+#include "Skaia.h"
+#include "BitBoard.h"
+
+namespace Skaia
+{
+    namespace Attacks
+    {
+        // The eight directions a piece can slide in.
+        // The first four step towards higher square indices, the last four towards lower ones.
+        static const std::array<Position, 8> directions = {{
+            {0, 1}, {1, -1}, {1, 0}, {1, 1},
+            {0, -1}, {-1, 1}, {-1, 0}, {-1, -1}
+        }};
+
+        // These are filled in once when the program starts
+        extern std::array<std::array<BitBoard, 64>, 2> pawn_table; // [color][square]
+        extern std::array<BitBoard, 64> knight_table;
+        extern std::array<BitBoard, 64> king_table;
+        extern std::array<std::array<BitBoard, 64>, 8> ray_table; // [direction][square], ignoring blockers
+        extern std::array<std::array<BitBoard, 64>, 64> between_table; // [from][to]
+        extern std::array<std::array<BitBoard, 64>, 64> line_table; // [from][to]
+
+        inline BitBoard pawn(Color color, int square) { return pawn_table[color][square]; }
+        inline BitBoard knight(int square) { return knight_table[square]; }
+        inline BitBoard king(int square) { return king_table[square]; }
+
+        // The squares strictly between two squares on the same rank, file or
+        //  diagonal, or nothing if they don't share one
+        inline BitBoard between(int from, int to) { return between_table[from][to]; }
+        // The whole rank, file or diagonal through two squares (edge to edge),
+        //  or nothing if they don't share one
+        inline BitBoard line(int from, int to) { return line_table[from][to]; }
+
+        // All squares along a ray up to and including the first blocker
+        // This walks the ray, so it is only used to build the sliding attack tables.
+        inline BitBoard ray(int direction, int square, BitBoard occupied)
+        {
+            BitBoard attacks = ray_table[direction][square];
+            BitBoard blockers = attacks & occupied;
+            if (blockers.any())
+            {
+                int blocker = direction < 4 ? blockers.lsb() : blockers.msb();
+                attacks ^= ray_table[direction][blocker];
+            }
+            return attacks;
+        }
+
+        // Sliding attacks are looked up by hashing the blockers along the piece's lines
+        //  into a per-square slice of a shared table.
+        // With BMI2 the hash is a PEXT of the relevant occupancy, otherwise it is
+        //  a multiplication by a magic number found when the program starts.
+        struct Magic
+        {
+            BitBoard mask; // Squares whose occupancy matters (the lines without their last square)
+            uint64_t magic;
+            unsigned shift;
+            BitBoard* attacks; // This square's slice of the table
+
+            unsigned index(BitBoard occupied) const
+            {
+#ifdef SKAIA_USE_PEXT
+                return static_cast<unsigned>(_pext_u64(occupied.data, mask.data));
+#else
+                return static_cast<unsigned>(((occupied & mask).data * magic) >> shift);
+#endif
+            }
+        };
+        extern std::array<Magic, 64> bishop_magics;
+        extern std::array<Magic, 64> rook_magics;
+
+        inline BitBoard bishop(int square, BitBoard occupied)
+        {
+            const Magic& m = bishop_magics[square];
+            return m.attacks[m.index(occupied)];
+        }
+        inline BitBoard rook(int square, BitBoard occupied)
+        {
+            const Magic& m = rook_magics[square];
+            return m.attacks[m.index(occupied)];
+        }
+        inline BitBoard queen(int square, BitBoard occupied)
+        {
+            return bishop(square, occupied) | rook(square, occupied);
+        }
+
+        // Squares attacked by a piece of the given type and color standing on square
+        inline BitBoard piece(Type type, Color color, int square, BitBoard occupied)
+        {
+            switch (type)
+            {
+                case Pawn: return pawn(color, square);
+                case Bishop: return bishop(square, occupied);
+                case Knight: return knight(square);
+                case Rook: return rook(square, occupied);
+                case Queen: return queen(square, occupied);
+                case King: return king(square);
+                default: return BitBoard();
+            }
+        }
+    }
+}
@@ -1,24 +1,29 @@
 #pragma once
 
+#include <cstdint>
+
 #include "Skaia.h"
-#include "SkaiaPiece.h"
-#include "SkaiaSimpleSmallState.h"
+#include "SkaiaAction.h"
+#include "BitBoard.h"
 
 // This class should be used to revert a Skaia::State to the previous state,
 //  so that so many copies of Skaia::State don't have to be made.
+// It only holds what can't be worked out from the action and the board
+//  after it, which keeps it small enough to make one at every node.
 
 namespace Skaia
 {
     class BackAction
     {
         public:
-            Type type; // To signify special moves like promotion
-            Piece actor; // The previous state of the acting piece
-            Piece taken; // The previous state of the taken piece (if one was taken), otherwise it is the default-constructed Piece
-            uint64_t old_action; // The eighth-oldest action to be re-added to history, or 0 if there isn't enough history
-            int double_moved_pawn_id; // -1 if there was no previously double moved pawn
-            int since_pawn_or_capture;
+            Action action; // The action that was applied
+            Type taken; // The type of the piece taken (a Pawn for en passant), or Empty
+            int16_t reversible; // The previous State::reversible
+            int8_t double_moved_pawn; // Square of the previously double moved pawn, or -1
             bool captured;
+            int16_t since_pawn_or_capture;
+            BitBoard special; // The previous castling rights
+            uint64_t hash; // The previous Zobrist hash
     };
+    static_assert(sizeof(BackAction) <= 32, "BackAction should stay small");
 }
-
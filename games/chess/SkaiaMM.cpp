@@ -1,236 +1,446 @@
 #include "SkaiaMM.h"
+#include "SkaiaMovePicker.h"
 
 #include <limits>
+#include <cmath>
 #include <iostream>
 #include <algorithm>
 
 namespace Skaia
 {
-    MMReturn minimax(const State& cstate, Color me, int depth_remaining, int quiescent_depth,
-            int lower, int upper, HistoryTable &ht)
+    namespace
     {
-        LOG("minimax(" << depth_remaining << ", " << lower << ", " << upper << ")");
-        // Cast away const-ness (it's ok, back_actions SHOULD return it to the original state)
-        State& state = const_cast<State&>(cstate);
-        
-        static const Action empty_action(Position(-1, -1), Position(-1, -1), Empty);
+        const Action empty_action;
 
-        auto moves = state.generate_actions();
-        bool stalemate = moves.empty();
-        bool draw = state.draw();
-        bool quiescent = state.quiescent();
-        // Base case, terminal node
-        if (stalemate || draw || (depth_remaining == 0 && (quiescent || quiescent_depth == 0)))
+        // Scores stay within +-infinity so that they can always be negated
+        const int infinity = std::numeric_limits<int>::max();
+
+        // The first aspiration window is this far either side of the guess,
+        //  beyond max_aspiration_delta the window is opened all the way
+        const int aspiration_delta = 50;
+        const int max_aspiration_delta = 5000;
+
+        // What heuristic gives a checkmate, any score this big means someone gets mated
+        const int checkmate = 100000;
+
+        // Null moves are tried this many ply or more from a leaf, and searched this much shallower
+        const int null_move_depth = 3;
+        int null_move_reduction(int depth_remaining) { return depth_remaining > 6 ? 3 : 2; }
+        // A null move cutoff this many ply or more from a leaf is checked by a search without null moves
+        const int null_move_verification_depth = 6;
+
+        // Late move reductions: how many ply shallower to search a quiet action,
+        //  by [depth_remaining][how many actions were tried before it].
+        // Later actions are less likely to be any good, so they are reduced more.
+        typedef std::array<std::array<int, 64>, 64> ReductionTable;
+        ReductionTable make_reductions()
         {
-            LOG("minimax: base case");
-            return MMReturn{heuristic(state, me, stalemate, draw), empty_action, 1};
+            ReductionTable reductions{};
+            for (int depth = 1; depth < 64; ++depth)
+            {
+                for (int index = 1; index < 64; ++index)
+                {
+                    reductions[depth][index] = static_cast<int>(0.5 + std::log(depth) * std::log(index) / 2.0);
+                }
+            }
+            return reductions;
         }
-        else
+        const ReductionTable reductions = make_reductions();
+        // The first few actions and the states close to a leaf are never reduced
+        const int reduction_min_index = 3;
+        const int reduction_min_depth = 3;
+        // A history score this high means an action was best often enough to be reduced less
+        const int good_history = 8;
+
+        // How far the heuristic may move beyond the material a capture wins
+        const int delta_margin = 1000;
+
+        // Everything a search needs besides the state and the window
+        struct Context
         {
-            // Sort moves by history table scores
-            // OPTIMIZE: Get scores for all actions at once
-            std::sort(moves.begin(), moves.end(), [&](const Action &first, const Action &second) {
-                    return ht.get_score(first) > ht.get_score(second);
-            });
-            
-            bool maximizing = (state.turn % 2 ? Black : White) == me;
-            // Initialize our "best" action with the worst possible action
-            auto starting_heuristic = maximizing ? std::numeric_limits<int>::lowest() :
-                std::numeric_limits<int>::max();
-            MMReturn best = MMReturn{starting_heuristic, empty_action, 0};
-            for (auto& action : moves)
+            Color me;
+            HistoryTable &ht;
+            TranspositionTable &tt;
+            SearchStack &ss;
+            std::atomic<bool> *stop;
+            int null_move_min_ply; // No null moves are tried closer to the root than this, while verifying
+        };
+
+        // The policies negamax is specialized on. Child is the policy for the states below.
+        // Plain never stops early, so the hot path has no atomic loads.
+        struct Plain
+        {
+            static const bool interruptable = false;
+            typedef Plain Child;
+        };
+        // Stops trying new actions once the stop flag is set
+        struct Interruptable
+        {
+            static const bool interruptable = true;
+            typedef Interruptable Child;
+        };
+
+        // Whether the player to move has more than a king and pawns, without
+        //  another piece zugzwang is too common for null moves to be trusted
+        bool has_pieces(const State &state)
+        {
+            Color color = state.to_move();
+            return (state.pieces(color) & ~state.pieces(color, Pawn) & ~state.pieces(color, King)).any();
+        }
+
+        // Converts between scores for the player to move in state and scores for me
+        int for_me(const State &state, Color me, int score)
+        {
+            return state.to_move() == me ? score : -score;
+        }
+
+        // Returns true if the transposition table already knows enough about this
+        //  state to answer the search, and sets ret to that answer.
+        // The stored action has to be legal, this guards
+        //  against two states sharing the same hash.
+        bool probe_transposition(const TranspositionTable::Entry *entry, const State &state,
+                const State::Restrictions &r, int depth_remaining, int lower, int upper,
+                MMReturn &ret)
+        {
+            if (entry == nullptr || entry->depth < depth_remaining)
             {
-                LOG("minimax: action: " << action);
-                // Apply, recurse, and unapply the action
-                auto back_action = state.apply_action(action);
-                auto ret = minimax(state, me, depth_remaining - (depth_remaining != 0),
-                        quiescent_depth - (depth_remaining == 0), lower, upper, ht);
-                state.apply_back_action(back_action);
+                return false;
+            }
+            if ((entry->bound == TranspositionTable::Exact ||
+                    (entry->bound == TranspositionTable::Lower && entry->score >= upper) ||
+                    (entry->bound == TranspositionTable::Upper && entry->score <= lower)) &&
+                    state.is_legal(entry->action, r))
+            {
+                ret = MMReturn{entry->score, entry->action, 1};
+                return true;
+            }
+            return false;
+        }
 
-                best.states_evaluated += ret.states_evaluated;
-                if (maximizing)
+        // Stores the result of searching a state
+        void store_transposition(TranspositionTable &tt, const State &state, const MMReturn &best,
+                int depth_remaining, int lower, int upper)
+        {
+            auto bound = best.heuristic <= lower ? TranspositionTable::Upper :
+                best.heuristic >= upper ? TranspositionTable::Lower : TranspositionTable::Exact;
+            tt.store(state.zobrist.hash, best.heuristic, best.action, depth_remaining, bound);
+        }
+
+        // Searches only the captures and promotions (or everything when in check), until
+        //  the state is quiet enough for the heuristic to be trusted.
+        // The player to move may also "stand pat" and take the heuristic as it is.
+        MMReturn quiesce(State &state, Context &c, int lower, int upper)
+        {
+            LOG("quiesce(" << lower << ", " << upper << ")");
+            if (state.draw(c.ss.ply(state)))
+            {
+                return MMReturn{heuristic(state, c.me, false, true), empty_action, 1};
+            }
+            // No deeper than State::keys has room for
+            if (c.ss.ply(state) >= SearchStack::max_ply)
+            {
+                return MMReturn{for_me(state, c.me, heuristic(state, c.me, false, false)), empty_action, 1};
+            }
+            MovePicker picker(state, c.ht);
+            bool in_check = picker.restrictions.checkers.any();
+            MMReturn best{-infinity, empty_action, 1};
+            if (!in_check)
+            {
+                best.heuristic = for_me(state, c.me, heuristic(state, c.me, false, false));
+                if (best.heuristic >= upper) return best;
+                lower = std::max(lower, best.heuristic);
+            }
+            Action action;
+            while (picker.next(action))
+            {
+                // Delta pruning: skip captures that couldn't reach lower even with a bit to spare,
+                //  and the ones that lose material
+                if (!in_check && (best.heuristic + picker.gain(action) * 1000 + delta_margin <= lower ||
+                            !state.see_ge(action, 0)))
                 {
-                    // Prune
-                    if (ret.heuristic > upper)
-                    {
-                        LOG("minimax: short circuit");
-                        best.heuristic = ret.heuristic;
-                        best.action = action;
-                        break;
-                    }
-                    // Set new best
-                    if (ret.heuristic > best.heuristic)
-                    {
-                        LOG("minimax: new best");
-                        best.heuristic = ret.heuristic;
-                        best.action = action;
-                        if (ret.heuristic > lower)
-                        {
-                            lower = ret.heuristic;
-                        }
-                    }
+                    continue;
                 }
-                else
+                auto back_action = state.apply_action(action);
+                auto ret = quiesce(state, c, -upper, -lower);
+                state.apply_back_action(back_action);
+                int score = -ret.heuristic;
+                best.states_evaluated += ret.states_evaluated;
+                if (score > best.heuristic)
                 {
-                    // Prune
-                    if (ret.heuristic < lower)
+                    best.heuristic = score;
+                    best.action = action;
+                    if (score > lower)
                     {
-                        LOG("minimax: short circuit");
-                        best.heuristic = ret.heuristic;
-                        best.action = action;
-                        break;
-                    }
-                    // Set new best
-                    if (ret.heuristic < best.heuristic)
-                    {
-                        LOG("minimax: new best");
-                        best.heuristic = ret.heuristic;
-                        best.action = action;
-                        if (ret.heuristic < upper)
-                        {
-                            upper = ret.heuristic;
-                        }
+                        lower = score;
+                        if (score >= upper) break;
                     }
                 }
             }
-            // Update history table value
-            ht.increase(best.action, 1, state.turn);
-
+            // In check with no way out
+            if (in_check && best.action == empty_action)
+            {
+                return MMReturn{for_me(state, c.me, heuristic(state, c.me, true, false)), empty_action, 1};
+            }
             return best;
         }
-    }
 
-    MMReturn interruptable_minimax(const State& cstate, Color me, int depth_remaining,
-            int quiescent_depth, int lower, int upper, HistoryTable &ht,
-            std::atomic<bool> &stop)
-    {
-        LOG("interruptable_minimax(" << depth_remaining << ", " << lower << ", " << upper << ")");
-        if (depth_remaining < 3)
+        // The one alpha-beta search behind all the minimax functions.
+        // Scores are for the player to move in state, and lower < upper are the window.
+        template <typename Policy>
+        MMReturn negamax(State &state, Context &c, int depth_remaining,
+                int lower, int upper)
         {
-            // Revert back to uninterruptable if depth is small enough
-            return minimax(cstate, me, depth_remaining, quiescent_depth, lower, upper, ht);
-        }
-        // Cast away const-ness (it's ok, back_actions SHOULD return it to the original state)
-        State& state = const_cast<State&>(cstate);
-        
-        static const Action empty_action(Position(-1, -1), Position(-1, -1), Empty);
+            LOG("negamax(" << depth_remaining << ", " << lower << ", " << upper << ")");
+            if (Policy::interruptable && depth_remaining < 3)
+            {
+                // Revert back to uninterruptable if depth is small enough
+                return negamax<Plain>(state, c, depth_remaining, lower, upper);
+            }
 
-        auto moves = state.generate_actions();
-        bool stalemate = moves.empty();
-        bool draw = state.draw();
-        bool quiescent = state.quiescent();
-        // Base case, terminal node
-        if (stalemate || draw || (depth_remaining == 0 && (quiescent || quiescent_depth == 0)))
-        {
-            return MMReturn{heuristic(state, me, stalemate, draw), empty_action, 1};
-        }
-        else
-        {
-            // Sort moves by history table scores
-            // OPTIMIZE: Get scores for all actions at once
-            std::sort(moves.begin(), moves.end(), [&](const Action &first, const Action &second) {
-                    return ht.get_score(first) > ht.get_score(second);
-            });
+            // The root always searches its actions, even in a drawn position, so that
+            //  there is a real action to play
+            int ply = c.ss.ply(state);
+            bool draw = ply > 0 && state.draw(ply);
+            // Base case, terminal node
+            if (draw)
+            {
+                LOG("negamax: draw");
+                return MMReturn{heuristic(state, c.me, false, true), empty_action, 1};
+            }
+            if (ply >= SearchStack::max_ply)
+            {
+                return quiesce(state, c, lower, upper);
+            }
+            // If the player to move can go back to a position from earlier in the search,
+            //  they can at least draw, which scores 0
+            bool can_repeat = ply > 0 && lower < 0 && state.upcoming_repetition(ply);
+            if (can_repeat)
+            {
+                LOG("negamax: upcoming repetition");
+                lower = 0;
+                if (lower >= upper) return MMReturn{0, empty_action, 1};
+            }
+            if (depth_remaining == 0)
+            {
+                return quiesce(state, c, lower, upper);
+            }
 
-            bool maximizing = (state.turn % 2 ? Black : White) == me;
-            // Initialize our "best" action with the worst possible action
-            auto starting_heuristic = maximizing ? std::numeric_limits<int>::lowest() :
-                std::numeric_limits<int>::max();
-            MMReturn best = MMReturn{starting_heuristic, empty_action, 0};
-            for (auto& action : moves)
+            TranspositionTable::Entry stored;
+            auto entry = c.tt.probe(state.zobrist.hash, stored) ? &stored : nullptr;
+            auto frame = c.ss.frame(state);
+            MovePicker picker(state, c.ht, entry != nullptr ? entry->action : empty_action,
+                    frame != nullptr ? frame->killers : std::array<Action, 2>(), c.ss.countermove(state));
+            MMReturn known{0, empty_action, 0};
+            if (probe_transposition(entry, state, picker.restrictions, depth_remaining, lower, upper, known))
             {
-                // Apply, recurse, and unapply the action
-                auto back_action = state.apply_action(action);
-                auto ret = interruptable_minimax(state, me, depth_remaining - (depth_remaining != 0),
-                        quiescent_depth - (depth_remaining == 0), lower, upper, ht, stop);
-                state.apply_back_action(back_action);
+                return known;
+            }
+            int original_lower = lower;
 
-                best.states_evaluated += ret.states_evaluated;
-                if (maximizing)
+            // Null move pruning: if passing still does as well as upper after a shallower
+            //  search, then some real action almost surely does too.
+            // Two passes in a row are never tried, the opponent's pass leaves the previous action null.
+            if (depth_remaining >= null_move_depth && lower + 1 == upper &&
+                    upper < checkmate && ply >= c.null_move_min_ply &&
+                    picker.restrictions.checkers.none() && has_pieces(state) &&
+                    c.ss.previous_action(state) != empty_action &&
+                    for_me(state, c.me, heuristic(state, c.me, false, false)) >= upper)
+            {
+                int reduced_depth = std::max(depth_remaining - 1 - null_move_reduction(depth_remaining), 0);
+                if (frame != nullptr) frame->action = empty_action;
+                auto back_action = state.apply_null_action();
+                auto ret = negamax<typename Policy::Child>(state, c, reduced_depth, -upper, -lower);
+                state.apply_null_back_action(back_action);
+                int score = -ret.heuristic;
+                if (score >= upper)
                 {
-                    // Prune
-                    if (ret.heuristic > upper)
+                    // Don't trust a checkmate found after a pass
+                    score = std::min(score, checkmate - 1);
+                    if (depth_remaining < null_move_verification_depth)
                     {
-                        LOG("minimax: short circuit");
-                        best.heuristic = ret.heuristic;
-                        best.action = action;
-                        break;
+                        LOG("negamax: null move cutoff");
+                        return MMReturn{score, empty_action, ret.states_evaluated};
                     }
-                    // Set new best
-                    if (ret.heuristic > best.heuristic)
+                    // Verify with a search that makes no null moves for a while
+                    int min_ply = c.null_move_min_ply;
+                    c.null_move_min_ply = ply + 3 * (depth_remaining - null_move_reduction(depth_remaining)) / 4;
+                    auto verified = negamax<Policy>(state, c, depth_remaining - null_move_reduction(depth_remaining),
+                            lower, upper);
+                    c.null_move_min_ply = min_ply;
+                    if (verified.heuristic >= upper)
                     {
-                        LOG("minimax: new best");
-                        best.heuristic = ret.heuristic;
-                        best.action = action;
-                        if (ret.heuristic > lower)
-                        {
-                            lower = ret.heuristic;
-                        }
+                        LOG("negamax: verified null move cutoff");
+                        return MMReturn{score, verified.action, ret.states_evaluated + verified.states_evaluated};
                     }
                 }
+            }
+
+            // Initialize our "best" action with the worst possible action
+            MMReturn best{-infinity, empty_action, 0};
+            bool in_check = picker.restrictions.checkers.any();
+            int tried = 0;
+            Action action;
+            while (picker.next(action))
+            {
+                LOG("negamax: action: " << action);
+                int index = tried++;
+                // Late quiet actions and captures that lose material may be reduced
+                bool reducible = depth_remaining >= reduction_min_depth && index >= reduction_min_index &&
+                    !in_check && (picker.is_quiet(action) || !state.see_ge(action, 0));
+                // Apply, recurse, and unapply the action
+                if (frame != nullptr) frame->action = action;
+                auto back_action = state.apply_action(action);
+                MMReturn ret;
+                int child_depth = depth_remaining - 1;
+                // Principal variation search: the first action is assumed to be the best,
+                //  the rest only have to be shown to be no better with a null window,
+                //  and are searched again with the full window if one turns out better
+                if (best.action == empty_action)
+                {
+                    ret = negamax<typename Policy::Child>(state, c, child_depth, -upper, -lower);
+                }
                 else
                 {
-                    // Prune
-                    if (ret.heuristic < lower)
+                    // Reducible actions are searched shallower, unless they escape
+                    //  or give check, and again at full depth if they beat lower
+                    int reduction = 0;
+                    if (reducible && !state.is_in_check(state.to_move()))
+                    {
+                        reduction = reductions[std::min(depth_remaining, 63)][std::min(index, 63)];
+                        int history = c.ht.get_score(!state.to_move(), action);
+                        if (history >= good_history) reduction -= 1;
+                        else if (history == 0) reduction += 1;
+                        reduction = std::max(0, std::min(reduction, child_depth - 1));
+                    }
+                    ret = negamax<typename Policy::Child>(state, c, child_depth - reduction, -lower - 1, -lower);
+                    if (reduction > 0 && lower < -ret.heuristic)
+                    {
+                        LOG("negamax: reduced re-search");
+                        int reduced_states = ret.states_evaluated;
+                        ret = negamax<typename Policy::Child>(state, c, child_depth, -lower - 1, -lower);
+                        ret.states_evaluated += reduced_states;
+                    }
+                    if (lower < -ret.heuristic && -ret.heuristic < upper)
                     {
-                        LOG("minimax: short circuit");
-                        best.heuristic = ret.heuristic;
-                        best.action = action;
-                        break;
+                        LOG("negamax: re-search");
+                        int scout_states = ret.states_evaluated;
+                        ret = negamax<typename Policy::Child>(state, c, child_depth, -upper, -lower);
+                        ret.states_evaluated += scout_states;
                     }
-                    // Set new best
-                    if (ret.heuristic < best.heuristic)
+                }
+                int score = -ret.heuristic;
+                state.apply_back_action(back_action);
+
+                best.states_evaluated += ret.states_evaluated;
+                // Set new best
+                if (score > best.heuristic)
+                {
+                    LOG("negamax: new best");
+                    best.heuristic = score;
+                    best.action = action;
+                    if (score > lower)
                     {
-                        LOG("minimax: new best");
-                        best.heuristic = ret.heuristic;
-                        best.action = action;
-                        if (ret.heuristic < upper)
+                        lower = score;
+                        // Prune
+                        if (score >= upper)
                         {
-                            upper = ret.heuristic;
+                            LOG("negamax: short circuit");
+                            if (picker.is_quiet(action)) c.ss.add_cutoff(state, action);
+                            break;
                         }
                     }
                 }
                 // Check if another thread wants us to stop
                 //  We do this AFTER we set a new best so that we should always
                 //  have a valid action ready to return.
-                if (stop)
+                if (Policy::interruptable && c.stop->load(std::memory_order_relaxed))
                 {
-                    LOG("interruptable_minimax: stop");
+                    LOG("negamax: stop");
                     break;
                 }
             }
+            // No moves, so checkmate or stalemate
+            if (best.action == empty_action)
+            {
+                return MMReturn{for_me(state, c.me, heuristic(state, c.me, true, draw)), empty_action, 1};
+            }
+            if (can_repeat) best.heuristic = std::max(best.heuristic, 0);
             // Update history table value
-            ht.increase(best.action, 1, state.turn);
+            c.ht.increase(state.to_move(), best.action, 1);
+            // A search that was stopped early may have missed the best action
+            if (!(Policy::interruptable && c.stop->load(std::memory_order_relaxed)))
+            {
+                store_transposition(c.tt, state, best, depth_remaining, original_lower, upper);
+            }
 
             return best;
         }
+
+        // Runs negamax from the root, with the window and result given for me
+        template <typename Policy>
+        MMReturn search(const State &cstate, Context &c, int depth_remaining,
+                int lower, int upper)
+        {
+            // Cast away const-ness (it's ok, back_actions SHOULD return it to the original state)
+            State &state = const_cast<State&>(cstate);
+            lower = std::max(lower, -infinity);
+            if (state.to_move() != c.me)
+            {
+                std::swap(lower, upper);
+                lower = -lower;
+                upper = -upper;
+            }
+            MMReturn ret = negamax<Policy>(state, c, depth_remaining, lower, upper);
+            ret.heuristic = for_me(state, c.me, ret.heuristic);
+            return ret;
+        }
     }
 
-    std::vector<std::pair<Action, MMReturn>> pondering_minimax(const State& cstate,
-            Color me, int depth_remaining, int quiescent_depth, int lower, int upper,
-            HistoryTable &ht, std::atomic<bool> &stop)
+    MMReturn minimax(const State& cstate, Color me, int depth_remaining,
+            int lower, int upper, HistoryTable &ht, TranspositionTable &tt, SearchStack &ss)
     {
-        LOG("pondering_minimax");
-        // Cast away const-ness (it's ok, back_actions SHOULD return it to the original state)
-        State& state = const_cast<State&>(cstate);
-        
-        static const Action empty_action(Position(-1, -1), Position(-1, -1), Empty);
+        Context c{me, ht, tt, ss, nullptr, 0};
+        return search<Plain>(cstate, c, depth_remaining, lower, upper);
+    }
 
-        auto moves = state.generate_actions();
+    MMReturn interruptable_minimax(const State& cstate, Color me, int depth_remaining,
+            int lower, int upper, HistoryTable &ht,
+            TranspositionTable &tt, SearchStack &ss, std::atomic<bool> &stop)
+    {
+        Context c{me, ht, tt, ss, &stop, 0};
+        return search<Interruptable>(cstate, c, depth_remaining, lower, upper);
+    }
 
-        std::vector<std::pair<Action, MMReturn>> bests;
-        for (auto& action : moves)
+    MMReturn aspiration_minimax(const State& cstate, Color me, int depth_remaining,
+            int guess, HistoryTable &ht, TranspositionTable &tt,
+            SearchStack &ss, std::atomic<bool> &stop)
+    {
+        Context c{me, ht, tt, ss, &stop, 0};
+        int delta = aspiration_delta;
+        int lower = std::max(guess - delta, -infinity);
+        int upper = std::min(guess + delta, infinity);
+        int states_evaluated = 0;
+        while (true)
         {
-            LOG("pondering_minimax: " << action);
-            auto back_action = state.apply_action(action);
-            bests.emplace_back(action, interruptable_minimax(state, me, depth_remaining - 1,
-                        quiescent_depth, lower, upper, ht, stop));
-            std::cout << bests.back().second.heuristic << " "
-                << bests.back().second.action << std::endl; // TODO: Remove
-            state.apply_back_action(back_action);
-            if (stop) break;
+            LOG("aspiration_minimax(" << lower << ", " << upper << ")");
+            MMReturn ret = search<Interruptable>(cstate, c, depth_remaining, lower, upper);
+            ret.states_evaluated += states_evaluated;
+            if (stop || (lower < ret.heuristic && ret.heuristic < upper))
+            {
+                return ret;
+            }
+            states_evaluated = ret.states_evaluated;
+            // Widen the side that failed, and give up on windows once they get too wide
+            delta *= 4;
+            if (ret.heuristic <= lower)
+            {
+                lower = delta > max_aspiration_delta ? -infinity : std::max(ret.heuristic - delta, -infinity);
+            }
+            else
+            {
+                upper = delta > max_aspiration_delta ? infinity : std::min(ret.heuristic + delta, infinity);
+            }
         }
-        return bests;
     }
 
     int heuristic(const State& state, Color me, bool stalemate, bool draw)
@@ -249,7 +459,7 @@ namespace Skaia
             h += state.count_pawn_advancement(me) * 20;
             // Force moves
             h += 8;
-            h -= state.pieces_by_color_and_type[!me][King][0]->moves.size();
+            h -= state.count_king_moves(!me);
             // Put the king in check
             h += state.is_in_check(!me) ? 5 : 0;
         }
@@ -267,7 +477,7 @@ namespace Skaia
         {
             if (state.is_in_check(current)) // Checkmate
             {
-                h = (current == me) ? -100000 : 100000;
+                h = (current == me) ? -checkmate : checkmate;
             }
             else
             {
@@ -3,6 +3,8 @@
 
 #include "SkaiaState.h"
 #include "HistoryTable.h"
+#include "TranspositionTable.h"
+#include "SkaiaSearchStack.h"
 
 #include <map>
 #include <atomic>
@@ -17,20 +19,23 @@ namespace Skaia
     };
 
     // looks depth_remaining ply deep from the given state and returns
-    //  the best heuristic and move that leads there.
-    // Min/Max player is a function of .turn variable in state.
-    MMReturn minimax(const State& cstate, Color me, int depth_remaining, int quiescent_depth,
-            int lower, int upper, HistoryTable &ht);
+    //  the best heuristic and move that leads there, then searches captures
+    //  until the leaves are quiet.
+    // Min/Max player is a function of .turn variable in state, and the results are for me.
+    // ss must have been made from the state at the root of the search.
+    MMReturn minimax(const State& cstate, Color me, int depth_remaining,
+            int lower, int upper, HistoryTable &ht, TranspositionTable &tt, SearchStack &ss);
 
     // Same as minimax, but stops trying new actions when &stop is true
     MMReturn interruptable_minimax(const State& cstate, Color me, int depth_remaining,
-            int quiescent_depth, int lower, int upper, HistoryTable &ht,
-            std::atomic<bool> &stop);
-
-    // Like minimax(), but does no pruning on the top level, and returns the best action found for each top-level action
-    std::vector<std::pair<Action, MMReturn>> pondering_minimax(const State& cstate, Color me,
-            int depth_remaining, int quiescent_depth, int lower, int upper,
-            HistoryTable &ht, std::atomic<bool> &stop);
+            int lower, int upper, HistoryTable &ht,
+            TranspositionTable &tt, SearchStack &ss, std::atomic<bool> &stop);
+
+    // Same as interruptable_minimax, but searches a narrow window around guess (the score
+    //  for me of a shallower search) first, and only widens it when the real score is outside
+    MMReturn aspiration_minimax(const State& cstate, Color me, int depth_remaining,
+            int guess, HistoryTable &ht, TranspositionTable &tt,
+            SearchStack &ss, std::atomic<bool> &stop);
 
     // Material + net checks
     int heuristic(const State& state, Color me, bool stalemate, bool draw);
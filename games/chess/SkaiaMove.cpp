@@ -0,0 +1,41 @@
+#include "SkaiaMove.h"
+
+#include <cstdlib>
+
+namespace Skaia
+{
+    Action action_from_move(const State& state, const Chess::Move& move)
+    {
+        Position from(rank_to_skaia(move.fromRank), file_to_skaia(move.fromFile));
+        Position to(rank_to_skaia(move.toRank), file_to_skaia(move.toFile));
+        Type promotion = move.promotion.empty() ? Empty : type_to_skaia(move.promotion);
+
+        Type type = state.at(from);
+        // Detect double pawn move
+        if (type == Pawn && std::abs(to.rank - from.rank) == 2)
+        {
+            promotion = Pawn;
+        }
+        // Detect en-passant
+        else if (type == Pawn && to.file != from.file && state.at(to) == Empty)
+        {
+            promotion = King;
+        }
+        // Detect castling
+        else if (type == King && std::abs(from.file - to.file) == 2)
+        {
+            promotion = King;
+        }
+        return Action(from, to, promotion);
+    }
+
+    MoveFields move_fields(const Action& action)
+    {
+        Position from = action.from(), to = action.to();
+        Type promotion = action.promotion();
+        bool promoting = promotion != Empty && promotion != Pawn && promotion != King;
+        return MoveFields{file_from_skaia(from.file), rank_from_skaia(from.rank),
+            file_from_skaia(to.file), rank_from_skaia(to.rank),
+            promoting ? type_from_skaia(promotion) : std::string()};
+    }
+}
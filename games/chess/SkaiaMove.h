@@ -0,0 +1,28 @@
+#pragma once
+
+// Conversions between Skaia's Action and the framework's Chess::Move.
+
+#include <string>
+
+#include "move.h"
+
+#include "SkaiaAction.h"
+#include "SkaiaState.h"
+
+namespace Skaia
+{
+    // The action a move made. The state must be the one before the move,
+    //  it is needed to tell double pawn moves, en passant and castling apart.
+    Action action_from_move(const State& state, const Chess::Move& move);
+
+    // The arguments for Chess::Piece::move which make an action
+    struct MoveFields
+    {
+        std::string from_file;
+        int from_rank;
+        std::string to_file;
+        int to_rank;
+        std::string promotion; // Empty unless a pawn is promoting
+    };
+    MoveFields move_fields(const Action& action);
+}
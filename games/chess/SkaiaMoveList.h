@@ -0,0 +1,60 @@
+#pragma once
+
+// A list of actions which keeps its storage inside itself rather than on the heap,
+//  so generating the moves for every state in a search never calls the allocator.
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "SkaiaAction.h"
+
+namespace Skaia
+{
+    class MoveList
+    {
+        public:
+            // No legal position has more than 218 moves, but generate_filtered_actions
+            //  first lists pseudo-legal moves, which there can be a few more of.
+            static const size_t capacity = 256;
+
+            typedef Action* iterator;
+            typedef const Action* const_iterator;
+
+            MoveList() : count(0) {}
+            // Only the filled part is copied
+            MoveList(const MoveList& source) : count(0) { *this = source; }
+            MoveList& operator=(const MoveList& source)
+            {
+                count = source.count;
+                std::copy(source.begin(), source.end(), begin());
+                return *this;
+            }
+
+            void push_back(const Action& action) { new (&storage[count++]) Action(action); }
+            template <typename... Args>
+            void emplace_back(Args&&... args) { new (&storage[count++]) Action(std::forward<Args>(args)...); }
+            // Drops every action from new_end onwards, for use after std::remove_if
+            void truncate(const_iterator new_end) { count = new_end - begin(); }
+            void clear() { count = 0; }
+
+            size_t size() const { return count; }
+            bool empty() const { return count == 0; }
+
+            Action& operator[](size_t index) { return begin()[index]; }
+            const Action& operator[](size_t index) const { return begin()[index]; }
+
+            iterator begin() { return reinterpret_cast<Action*>(storage); }
+            iterator end() { return begin() + count; }
+            const_iterator begin() const { return reinterpret_cast<const Action*>(storage); }
+            const_iterator end() const { return begin() + count; }
+
+        private:
+            // Left uninitialized until an action is added, which is fine since Action has no destructor
+            static_assert(std::is_trivially_destructible<Action>::value, "Action must be trivially destructible");
+            typename std::aligned_storage<sizeof(Action), alignof(Action)>::type storage[capacity];
+            size_t count;
+    };
+}
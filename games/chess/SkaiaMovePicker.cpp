@@ -0,0 +1,183 @@
+#include "SkaiaMovePicker.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace Skaia
+{
+    namespace
+    {
+        // Rough piece values for ordering captures
+        const std::array<int, NumberOfTypes> values = {{0, 1, 3, 3, 5, 9, 20}};
+    }
+
+    MovePicker::MovePicker(const State& state, const HistoryTable& ht, const Action& tt_action,
+            const std::array<Action, 2>& killers, const Action& countermove) :
+        restrictions(state.restrictions(state.to_move())), state(state), ht(ht), tt_action(tt_action),
+        stage(TTAction), quiescent(false), refutations{{killers[0], killers[1], countermove}}, current_refutation(0),
+        moves(), current(0), bad_captures(), current_bad(0)
+    {
+        if (tt_action == Action() || !state.is_legal(tt_action, restrictions))
+        {
+            stage = GenerateCaptures;
+        }
+        // Only keep the quiet actions that aren't tried some other way
+        for (size_t i = 0; i < refutations.size(); ++i)
+        {
+            auto& refutation = refutations[i];
+            if (refutation == Action() || refutation == this->tt_action ||
+                    std::find(refutations.begin(), refutations.begin() + i, refutation) != refutations.begin() + i ||
+                    !is_quiet(refutation) || !state.is_legal(refutation, restrictions))
+            {
+                refutation = Action();
+            }
+        }
+    }
+
+    MovePicker::MovePicker(const State& state, const HistoryTable& ht) :
+        restrictions(state.restrictions(state.to_move())), state(state), ht(ht), tt_action(),
+        stage(GenerateCaptures), quiescent(true), refutations(), current_refutation(0),
+        moves(), current(0), bad_captures(), current_bad(0)
+    {
+    }
+
+    bool MovePicker::next(Action& action)
+    {
+        switch (stage)
+        {
+            case TTAction:
+                stage = GenerateCaptures;
+                action = tt_action;
+                return true;
+
+            case GenerateCaptures:
+                state.generate_actions(State::Captures, restrictions, moves);
+                score_captures();
+                stage = GoodCaptures;
+                // Fall through
+            case GoodCaptures:
+                while (current < moves.size())
+                {
+                    action = pick_best();
+                    if (action == tt_action) continue;
+                    // A capture that may lose material waits until after the quiet moves
+                    if (scores[current - 1] < 0 && !quiescent)
+                    {
+                        bad_captures.push_back(action);
+                        continue;
+                    }
+                    return true;
+                }
+                stage = Refutations;
+                // Quiet moves are only needed to get out of check
+                if (quiescent && restrictions.checkers.none())
+                {
+                    stage = Done;
+                    return false;
+                }
+                // Fall through
+            case Refutations:
+                while (current_refutation < refutations.size())
+                {
+                    action = refutations[current_refutation++];
+                    if (action != Action()) return true;
+                }
+                stage = GenerateQuiets;
+                // Fall through
+            case GenerateQuiets:
+                moves.clear();
+                current = 0;
+                state.generate_actions(State::Quiets, restrictions, moves);
+                score_quiets();
+                stage = Quiets;
+                // Fall through
+            case Quiets:
+                while (current < moves.size())
+                {
+                    action = pick_best();
+                    if (action != tt_action && !is_refutation(action)) return true;
+                }
+                stage = BadCaptures;
+                // Fall through
+            case BadCaptures:
+                // These were put off in order of their scores
+                if (current_bad < bad_captures.size())
+                {
+                    action = bad_captures[current_bad++];
+                    return true;
+                }
+                stage = Done;
+                // Fall through
+            case Done:
+                return false;
+        }
+        return false;
+    }
+
+    bool MovePicker::is_quiet(const Action& action) const
+    {
+        Type promotion = action.promotion();
+        if (state.squares[action.to_square()] != Empty) return false;
+        // Castling is quiet, but promotion and en passant are not
+        return promotion == Empty || promotion == Pawn ||
+            (promotion == King && state.squares[action.from_square()] == King);
+    }
+
+    int MovePicker::gain(const Action& action) const
+    {
+        Type attacker = state.squares[action.from_square()];
+        Type victim = state.squares[action.to_square()];
+        Type promotion = action.promotion();
+        // En passant flags use King, but they take a pawn
+        if (promotion == King)
+        {
+            return attacker == Pawn ? values[Pawn] : 0;
+        }
+        return values[victim] + (attacker == Pawn && promotion != Pawn ? values[promotion] : 0);
+    }
+
+    bool MovePicker::is_refutation(const Action& action) const
+    {
+        return std::find(refutations.begin(), refutations.end(), action) != refutations.end();
+    }
+
+    void MovePicker::score_captures()
+    {
+        for (size_t i = 0; i < moves.size(); ++i)
+        {
+            const Action& action = moves[i];
+            Type attacker = state.squares[action.from_square()];
+            int gain = this->gain(action);
+            // Most valuable victim, then least valuable attacker
+            scores[i] = gain * 32 - values[attacker];
+            // Captures that lose material once the other player takes back are
+            //  pushed below zero but keep their order.
+            // Taking something worth at least the attacker can't lose anything.
+            if (values[attacker] > gain && !state.see_ge(action, 0))
+            {
+                scores[i] -= 1024;
+            }
+        }
+    }
+
+    void MovePicker::score_quiets()
+    {
+        Color color = state.to_move();
+        for (size_t i = 0; i < moves.size(); ++i)
+        {
+            scores[i] = ht.get_score(color, moves[i]);
+        }
+    }
+
+    const Action& MovePicker::pick_best()
+    {
+        size_t best = current;
+        for (size_t i = current + 1; i < moves.size(); ++i)
+        {
+            if (scores[i] > scores[best]) best = i;
+        }
+        std::swap(moves[best], moves[current]);
+        std::swap(scores[best], scores[current]);
+        return moves[current++];
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+// Hands out the moves of a state one at a time, in the order they are
+//  most likely to cause a cutoff, and only generates and scores each
+//  group of moves when the search gets that far:
+//  1. The transposition table's move
+//  2. Captures (and promotions) which don't lose material, most valuable victim first
+//  3. The killer moves and the countermove (quiet moves that caused cutoffs before)
+//  4. Quiet moves, by history score
+//  5. The captures that lose material, by static exchange evaluation
+// For quiescence search it only hands out the captures (and promotions),
+//  most valuable victim first, or every move when in check.
+
+#include <array>
+
+#include "SkaiaState.h"
+#include "SkaiaMoveList.h"
+#include "HistoryTable.h"
+#include "SkaiaSearchStack.h"
+
+namespace Skaia
+{
+    class MovePicker
+    {
+        public:
+            // tt_action, the killers and countermove may be the null action, or any
+            //  action that was good in a similar state, they are only tried if they are legal
+            MovePicker(const State& state, const HistoryTable& ht, const Action& tt_action,
+                    const std::array<Action, 2>& killers = {{}}, const Action& countermove = Action());
+            // For quiescence search
+            MovePicker(const State& state, const HistoryTable& ht);
+
+            // Sets action to the next move to try, returns false once there are none left
+            bool next(Action& action);
+
+            // Whether an action is neither a capture nor a promotion
+            bool is_quiet(const Action& action) const;
+
+            // The most material, in pawns, that an action could win: what it takes plus what it promotes to
+            int gain(const Action& action) const;
+
+            // Restrictions for the state's current player, worked out once for every stage
+            const State::Restrictions restrictions;
+
+        private:
+            enum Stage {TTAction, GenerateCaptures, GoodCaptures, Refutations, GenerateQuiets, Quiets, BadCaptures, Done};
+
+            const State& state;
+            const HistoryTable& ht;
+            Action tt_action;
+            Stage stage;
+            bool quiescent;
+            // The killers and then the countermove, with any that can't be tried set to the null action
+            std::array<Action, 3> refutations;
+            size_t current_refutation;
+
+            // Moves waiting to be handed out, and their scores
+            MoveList moves;
+            std::array<int, MoveList::capacity> scores;
+            size_t current;
+            // Captures put off until after the quiet moves
+            MoveList bad_captures;
+            size_t current_bad;
+
+            bool is_refutation(const Action& action) const;
+            void score_captures();
+            void score_quiets();
+            // Swaps the best scoring move left into place and returns it
+            const Action& pick_best();
+    };
+}
@@ -0,0 +1,33 @@
+#include "SkaiaPerft.h"
+
+namespace Skaia
+{
+    uint64_t perft(State& state, int depth, bool filtered)
+    {
+        if (depth == 0) return 1;
+        auto actions = filtered ? state.generate_filtered_actions() : state.generate_actions();
+        // Every action leads to exactly one state, so there is no need to apply them
+        if (depth == 1) return actions.size();
+        uint64_t count = 0;
+        for (auto& action : actions)
+        {
+            auto back_action = state.apply_action(action);
+            count += perft(state, depth - 1, filtered);
+            state.apply_back_action(back_action);
+        }
+        return count;
+    }
+
+    std::vector<std::pair<Action, uint64_t>> divide(State& state, int depth, bool filtered)
+    {
+        std::vector<std::pair<Action, uint64_t>> counts;
+        auto actions = filtered ? state.generate_filtered_actions() : state.generate_actions();
+        for (auto& action : actions)
+        {
+            auto back_action = state.apply_action(action);
+            counts.emplace_back(action, perft(state, depth - 1, filtered));
+            state.apply_back_action(back_action);
+        }
+        return counts;
+    }
+}
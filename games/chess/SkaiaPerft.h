@@ -0,0 +1,21 @@
+#pragma once
+
+// Perft counts every line of play to a fixed depth. The counts for well known
+//  positions are published, so it is used to check the move generator, and
+//  to measure how fast it is.
+
+#include "SkaiaState.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace Skaia
+{
+    // Counts the states exactly depth ply after the given state.
+    // With filtered set, moves come from generate_filtered_actions instead of generate_actions.
+    uint64_t perft(State& state, int depth, bool filtered = false);
+
+    // Runs perft on the state after each of the current player's actions
+    std::vector<std::pair<Action, uint64_t>> divide(State& state, int depth, bool filtered = false);
+}
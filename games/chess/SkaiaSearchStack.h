@@ -0,0 +1,72 @@
+#pragma once
+
+// Move ordering information kept for each ply of a search.
+// Unlike the HistoryTable this is meant for one search thread at a time.
+
+#include <array>
+#include <cstddef>
+
+#include "SkaiaAction.h"
+#include "SkaiaState.h"
+
+namespace Skaia
+{
+    class SearchStack
+    {
+        public:
+            static const int max_ply = State::max_ply;
+
+            struct Frame
+            {
+                std::array<Action, 2> killers; // Quiet actions that caused a cutoff at this ply, newest first
+                Action action; // The action being searched from this ply
+            };
+
+            size_t root_turn; // The state's turn at ply 0
+            std::array<Frame, max_ply> frames;
+            // The quiet action that last refuted an action, indexed by that action's [from][to]
+            std::array<std::array<Action, 64>, 64> countermoves;
+
+            SearchStack(const State& root) : root_turn(root.turn), frames(), countermoves() {}
+
+            // How far the state is from the root
+            int ply(const State& state) const { return static_cast<int>(state.turn - root_turn); }
+
+            // The frame for a state, or nullptr if the search went deeper than max_ply
+            Frame* frame(const State& state)
+            {
+                int p = ply(state);
+                return 0 <= p && p < max_ply ? &frames[p] : nullptr;
+            }
+
+            // The action the opponent just made to reach the state, or the null action if it isn't known
+            Action previous_action(const State& state) const
+            {
+                int p = ply(state);
+                return 0 < p && p <= max_ply ? frames[p - 1].action : Action();
+            }
+
+            // The action that last refuted the opponent's previous action
+            Action countermove(const State& state) const
+            {
+                Action previous = previous_action(state);
+                return previous == Action() ? Action() : countermoves[previous.from_square()][previous.to_square()];
+            }
+
+            // Remember a quiet action that caused a cutoff from the state
+            void add_cutoff(const State& state, const Action& action)
+            {
+                Frame* f = frame(state);
+                if (f != nullptr && f->killers[0] != action)
+                {
+                    f->killers[1] = f->killers[0];
+                    f->killers[0] = action;
+                }
+                Action previous = previous_action(state);
+                if (previous != Action())
+                {
+                    countermoves[previous.from_square()][previous.to_square()] = action;
+                }
+            }
+    };
+}
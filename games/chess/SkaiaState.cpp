@@ -4,547 +4,607 @@
 #include <iterator>
 #include <set>
 #include <map>
+#include <sstream>
+#include <stdexcept>
+#include <cctype>
 
 namespace Skaia
 {
-    State::State() : turn(0), pieces(), squares(),
-        pieces_by_color_and_type(), double_moved_pawn(nullptr), history(8),
-        since_pawn_or_capture(0), captured(false)/*, zobrist(13315146811210211749)*/
+    const int State::max_ply;
+    const int State::repetition_window;
+
+    State::State() : turn(0), pieces_by_color_and_type(), squares(), special(),
+        double_moved_pawn(-1), keys(), reversible(0), since_pawn_or_capture(0),
+        captured(false), zobrist()
     {
+        squares.fill(Empty);
         // Generate pieces
         static const std::vector<Type> order = {Rook, Knight, Bishop, Queen, King, Bishop, Knight, Rook};
-        auto create_piece = [this](const Piece& piece) {
-            pieces[piece.id] = piece;
-            Piece* ptr = &(pieces[piece.id]);
-            at(piece.pos).piece = ptr;
-            pieces_by_color_and_type[piece.color][piece.type].emplace_back(ptr);
-        };
         for (auto file = 0; file < 8; ++file)
         {
             // Home row
-            create_piece(Piece(Position(0, file), order[file], Black, file + 0*8, true));
-            create_piece(Piece(Position(7, file), order[file], White, file + 3*8, true));
+            place_piece(Piece(Position(0, file), order[file], Black));
+            place_piece(Piece(Position(7, file), order[file], White));
             // Pawns
-            create_piece(Piece(Position(1, file), Pawn, Black, file + 1*8, true));
-            create_piece(Piece(Position(6, file), Pawn, White, file + 2*8, true));
+            place_piece(Piece(Position(1, file), Pawn, Black));
+            place_piece(Piece(Position(6, file), Pawn, White));
+        }
+        // Nothing has moved yet
+        for (Color color : {White, Black})
+        {
+            special |= pieces(color, King) | pieces(color, Rook);
         }
-        // Generate checks
-        for (auto&& piece : pieces)
+        for (Color color : {White, Black})
         {
-            place_piece(&piece, piece.pos);
+            zobrist.update_castling(color, castling_state(color));
         }
+        zobrist.toggle_color(White);
     }
 
-    State::State(const State& source) : turn(source.turn), pieces(source.pieces), squares(),
-        pieces_by_color_and_type(), double_moved_pawn(nullptr), history(source.history),
-        since_pawn_or_capture(source.since_pawn_or_capture), captured(source.captured)
+    namespace
     {
-        auto make_pointer = [&, this](const Piece* piece) {
-            return piece == nullptr ? nullptr : &(this->pieces[piece->id]);
-        };
-        // Copy squares
-        for (auto i = 0; i < squares.size(); ++i)
+        // FEN letters for black pieces, indexed by Type, white uses the upper case
+        const std::string fen_letters = ".pbnrqk";
+    }
+
+    State State::from_fen(const std::string& fen)
+    {
+        State state;
+        state.pieces_by_color_and_type = {};
+        state.squares.fill(Empty);
+        state.special = BitBoard();
+        state.zobrist.hash = 0;
+
+        std::istringstream in(fen);
+        std::string board, side, castling("-"), en_passant("-");
+        int halfmove = 0, fullmove = 1;
+        in >> board >> side >> castling >> en_passant >> halfmove >> fullmove;
+
+        // Piece placement, starting from a8 which is Skaia's rank 0
+        Position pos(0, 0);
+        for (char c : board)
+        {
+            if (c == '/')
+            {
+                pos = Position(pos.rank + 1, 0);
+            }
+            else if (std::isdigit(c))
+            {
+                pos.file += c - '0';
+            }
+            else
+            {
+                auto type = fen_letters.find(static_cast<char>(std::tolower(c)));
+                if (type == std::string::npos || type == 0 || !inside(pos))
+                {
+                    throw std::invalid_argument("Bad piece placement in FEN: " + fen);
+                }
+                state.place_piece(Piece(pos, static_cast<Type>(type), std::isupper(c) ? White : Black));
+                pos.file += 1;
+            }
+        }
+        if (side != "w" && side != "b")
         {
-            squares[i].piece = make_pointer(source.squares[i].piece);
-            squares[i].checks = source.squares[i].checks;
+            throw std::invalid_argument("Bad side to move in FEN: " + fen);
         }
-        // Copy pieces_by_color_and_type
-        for (auto color = 0; color < 2; ++color)
+
+        // Castling rights only count when the king and rook are still at home
+        for (char c : castling)
         {
-            for (auto type = 0; type < NumberOfTypes; ++type)
+            Color color = std::isupper(c) ? White : Black;
+            int king = color == White ? 60 : 4;
+            int rook = std::tolower(c) == 'k' ? king + 3 : std::tolower(c) == 'q' ? king - 4 : -1;
+            if (rook != -1 && state.pieces(color, King).at(king) && state.pieces(color, Rook).at(rook))
             {
-                auto& sp = source.pieces_by_color_and_type[color][type];
-                std::transform(sp.cbegin(), sp.cend(),
-                        std::back_inserter(pieces_by_color_and_type[color][type]),
-                        [&](const Piece* piece) {
-                            return make_pointer(piece);
-                        });
+                state.special |= BitBoard::square(king) | BitBoard::square(rook);
             }
         }
-        // Copy double pawn
-        double_moved_pawn = make_pointer(source.double_moved_pawn);
-    }
-
-    bool State::draw() const
-    {
-        if (since_pawn_or_capture == 100) return true;
-        if (history.size() == 8)
+        for (Color color : {White, Black})
         {
-            return
-                history[0] == history[4] &&
-                history[1] == history[5] &&
-                history[2] == history[6] &&
-                history[3] == history[7];
+            state.zobrist.update_castling(color, state.castling_state(color));
         }
-        return false;
-    }
 
+        // FEN names the square behind the pawn, Skaia remembers the pawn itself
+        if (en_passant.size() == 2)
+        {
+            Position behind(rank_to_skaia(en_passant[1] - '0'), file_to_skaia(en_passant));
+            Position pawn = behind + Position(behind.rank == 5 ? -1 : 1, 0);
+            if ((behind.rank == 2 || behind.rank == 5) && inside(behind) && state.at(pawn) == Pawn)
+            {
+                state.double_moved_pawn = pawn.square();
+                state.zobrist.update_enpassant(pawn.file);
+            }
+        }
 
-    bool State::quiescent() const
-    {
-        return !is_in_check(Black) && !is_in_check(White) && !captured;
+        state.since_pawn_or_capture = halfmove;
+        state.turn = std::max(fullmove - 1, 0) * 2 + (side == "b" ? 1 : 0);
+        state.zobrist.toggle_color(state.to_move());
+        return state;
     }
 
-
-    void State::place_piece(Piece* piece, const Position& pos)
+    std::string State::to_fen() const
     {
-        LOG("place_piece");
-        // Place piece at location
-        piece->pos = pos;
-        at(pos).piece = piece;
-        // Update possible moves and checks
-        if (at(pos).checks.any())
-        {
-            auto& checks = at(pos).checks;
-            for (int i = 0; i < checks.size(); ++i)
+        std::ostringstream out;
+        for (int rank = 0; rank < 8; ++rank)
+        {
+            int empty = 0;
+            for (int file = 0; file < 8; ++file)
             {
-                if (checks[i])
+                Type type = at(rank, file);
+                if (type == Empty)
                 {
-                    auto& attacker = pieces[i];
-                    // Update moves
-                    attacker.moves.clear();
-                    possible_piece_moves(&attacker, attacker.moves);
-                    // Update checks
-                    switch (attacker.type)
-                    {
-                        case Bishop:
-                        case Rook:
-                        case Queen:
-                            // If the attacker is an enemy then keep his check on this square
-                            //  otherwise remove it
-                            checks[i] = attacker.color != piece->color;
-                            // Remove all checks beyond this point in the attacker's path
-                            auto delta = attacker.pos.direction_to(pos);
-                            Position new_pos = piece->pos;
-                            while (true)
-                            {
-                                new_pos += delta;
-                                if (!canTake(piece, new_pos)) break;
-                                at(new_pos).checks[i] = false;
-                                if (!empty(new_pos)) break;
-                            }
-                            break;
-                    }
+                    empty += 1;
+                    continue;
                 }
+                if (empty) out << empty;
+                empty = 0;
+                char letter = fen_letters[type];
+                out << (color_at(rank * 8 + file) == White ? static_cast<char>(std::toupper(letter)) : letter);
             }
+            if (empty) out << empty;
+            if (rank != 7) out << '/';
         }
-        // Update nearby pawns for double move
-        for (auto& pos : std::array<Position, 4>{{{-2, 0}, {-1, 0}, {1, 0}, {2, 0}}})
+        out << (to_move() == White ? " w " : " b ");
+
+        std::string castling;
+        if (castling_state(White) & 1) castling += 'K';
+        if (castling_state(White) & 2) castling += 'Q';
+        if (castling_state(Black) & 1) castling += 'k';
+        if (castling_state(Black) & 2) castling += 'q';
+        out << (castling.empty() ? "-" : castling) << ' ';
+
+        if (double_moved_pawn != -1)
         {
-            Position new_pos = piece->pos + pos;
-            if (inside(new_pos))
-            {
-                Piece *piece = at(new_pos).piece;
-                if (piece != nullptr && piece->type == Pawn)
-                {
-                    piece->moves.clear();
-                    possible_pawn_moves(piece, piece->moves);
-                }
-            }
+            Position pawn = Position::from_square(double_moved_pawn);
+            out << pawn + Position(color_at(double_moved_pawn) == White ? 1 : -1, 0);
         }
-        // Update sight lines and moves for this piece
-        check_piece(piece, true);
-        piece->moves.clear();
-        possible_piece_moves(piece, piece->moves);
+        else
+        {
+            out << '-';
+        }
+        out << ' ' << since_pawn_or_capture << ' ' << turn / 2 + 1;
+        return out.str();
     }
 
-    void State::remove_piece(Piece* piece)
+    bool State::draw(int ply) const
     {
-        LOG("remove_piece");
-        // Remove own checks and moves
-        check_piece(piece, false);
-        piece->moves.clear();
-
-        // Remove from board
-        at(piece->pos).piece = nullptr;
-        // Update nearby pawns for double move
-        for (auto& pos : std::array<Position, 4>{{{-2, 0}, {-1, 0}, {1, 0}, {2, 0}}})
-        {
-            Position new_pos = piece->pos + pos;
-            if (inside(new_pos))
+        if (since_pawn_or_capture >= 100) return true;
+        // Only positions with the same player to move can match, and it takes
+        //  at least two actions each to get back to one
+        int end = std::min(reversible, repetition_window);
+        bool repeated = false;
+        for (int i = 4; i <= end; i += 2)
+        {
+            if (key(i) == zobrist.hash)
             {
-                Piece *piece = at(new_pos).piece;
-                if (piece != nullptr && piece->type == Pawn)
-                {
-                    piece->moves.clear();
-                    possible_pawn_moves(piece, piece->moves);
-                }
+                if (i < ply || repeated) return true;
+                repeated = true;
             }
         }
-        // Check for blocking other pieces
-        if (at(piece->pos).checks.any())
+        return false;
+    }
+
+    bool State::upcoming_repetition(int ply) const
+    {
+        // The earlier position has the other player to move, one action from this one
+        int end = std::min(std::min(reversible, repetition_window), ply - 1);
+        for (int i = 3; i <= end; i += 2)
         {
-            auto& checks = at(piece->pos).checks;
-            for (int i = 0; i < checks.size(); ++i)
+            int from, to;
+            if (Zobrist::find_cuckoo(zobrist.hash ^ key(i), from, to) &&
+                    (Attacks::between(from, to) & occupied()).none())
             {
-                if (checks[i])
-                {
-                    auto& attacker = pieces[i];
-                    // Update moves
-                    attacker.moves.clear();
-                    possible_piece_moves(&attacker, attacker.moves);
-                    // Update ray checks
-                    switch (attacker.type)
-                    {
-                        case Bishop:
-                        case Rook:
-                        case Queen:
-                            check_ray(&attacker, attacker.pos.direction_to(piece->pos), true);
-                            break;
-                    }
-                }
+                // The piece is on one of the squares and the other is empty, it has to be ours to move
+                int square = squares[from] != Empty ? from : to;
+                if (color_at(square) == to_move()) return true;
             }
         }
+        return false;
     }
 
-    void State::kill_piece(Piece* piece)
+
+    bool State::quiescent() const
     {
-        LOG("kill_piece");
-        remove_piece(piece);
-        // Set dead and remove from pieces_by_color_and_type
-        piece->alive = false;
-        auto& v = pieces_by_color_and_type[piece->color][piece->type];
-        v.erase(std::find(v.begin(), v.end(), piece));
-        since_pawn_or_capture = 0;
-        captured = true;
+        return !is_in_check(Black) && !is_in_check(White) && !captured;
     }
 
-    void State::move_piece(const Position& from, const Position& to)
+    namespace
     {
-        LOG("move_piece");
-        Piece* piece = at(from).piece;
-        remove_piece(piece);
-        place_piece(piece, to);
+        // Piece values for the exchange evaluations, in pawns
+        const std::array<int, NumberOfTypes> see_values = {{0, 1, 3, 3, 5, 9, 100}};
     }
 
-    BackAction State::apply_action(const Action& action)
+    int State::see(const Action& action) const
     {
-        LOG("apply_action");
-        // Create a BackAction so that we can return to this state
-        Piece null_piece;
-        uint64_t old_action(history.size() == 8 ? history[0] : 0);
-        int double_moved_id = double_moved_pawn == nullptr ? -1 : double_moved_pawn->id;
-        BackAction back_action{action.promotion, Piece(*(at(action.from).piece)),
-            null_piece, old_action, double_moved_id, since_pawn_or_capture, captured};
-
-        // Record this action so we can check for draws later
-        history.push_back(at(action.from).piece->type << 8 | action.to.rank << 4 | action.to.file);
+        const auto& values = see_values;
+        int from = action.from_square(), to = action.to_square();
+        Type promotion = action.promotion();
+        Type actor = squares[from];
+        // Castling takes nothing and can't be taken back
+        if (actor == King && promotion == King) return 0;
 
-        since_pawn_or_capture += 1;
-        captured = false;
+        std::array<int, 32> gain;
+        BitBoard occupied = this->occupied() ^ BitBoard::square(from);
+        gain[0] = values[squares[to]];
+        if (actor == Pawn && promotion == King) // En passant
+        {
+            gain[0] = values[Pawn];
+            occupied ^= BitBoard::square(from - from % 8 + to % 8); // The taken pawn is beside the actor
+        }
+        // The piece standing on the target square, which the other player may take next
+        Type on_square = actor;
+        if (actor == Pawn && promotion != Empty && promotion != Pawn && promotion != King)
+        {
+            gain[0] += values[promotion] - values[Pawn];
+            on_square = promotion;
+        }
 
-        // Remove moves to en-passant the previously double-moved pawn
-        if (double_moved_pawn != nullptr)
+        auto both = [this](Type type) { return pieces(White, type) | pieces(Black, type); };
+        BitBoard diagonal = both(Bishop) | both(Queen);
+        BitBoard straight = both(Rook) | both(Queen);
+        BitBoard attackers = attackers_to(to, occupied) & occupied;
+        Color color = !to_move();
+        int d = 0;
+        while (d + 1 < static_cast<int>(gain.size()))
         {
-            Position adjacent = double_moved_pawn->pos + Position(0, 1);
-            // Reset double_moved_pawn so that this actually removes moves
-            double_moved_pawn = nullptr;
-            // Remove moves
-            if (inside(adjacent) && at(adjacent).piece != nullptr)
+            BitBoard mine = attackers & pieces(color);
+            if (mine.none()) break;
+            // Take with the least valuable piece
+            Type type = Pawn;
+            while ((mine & pieces(color, type)).none()) type = static_cast<Type>(type + 1);
+            d += 1;
+            gain[d] = values[on_square] - gain[d - 1];
+            occupied ^= BitBoard::square((mine & pieces(color, type)).lsb());
+            // Sliders behind the piece that just moved can now reach the square
+            if (type == Pawn || type == Bishop || type == Queen)
             {
-                // TODO: Combine possible_piece_moves and clear()
-                at(adjacent).piece->moves.clear();
-                possible_piece_moves(at(adjacent).piece, at(adjacent).piece->moves);
+                attackers |= Attacks::bishop(to, occupied) & diagonal;
             }
-            adjacent += Position(0, -2);
-            if (inside(adjacent) && at(adjacent).piece != nullptr)
+            if (type == Rook || type == Queen)
             {
-                at(adjacent).piece->moves.clear();
-                possible_piece_moves(at(adjacent).piece, at(adjacent).piece->moves);
+                attackers |= Attacks::rook(to, occupied) & straight;
             }
+            attackers &= occupied;
+            on_square = type;
+            color = !color;
+        }
+        // Each player only takes if it doesn't leave them worse off
+        while (d > 0)
+        {
+            gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+            d -= 1;
+        }
+        return gain[0];
+    }
+
+    bool State::see_ge(const Action& action, int threshold) const
+    {
+        const auto& values = see_values;
+        int from = action.from_square(), to = action.to_square();
+        Type promotion = action.promotion();
+        Type actor = squares[from];
+        if (actor == King && promotion == King) return 0 >= threshold;
+
+        BitBoard occupied = this->occupied() ^ BitBoard::square(from);
+        int gain = values[squares[to]];
+        if (actor == Pawn && promotion == King) // En passant
+        {
+            gain = values[Pawn];
+            occupied ^= BitBoard::square(from - from % 8 + to % 8);
+        }
+        Type on_square = actor;
+        if (actor == Pawn && promotion != Empty && promotion != Pawn && promotion != King)
+        {
+            gain += values[promotion] - values[Pawn];
+            on_square = promotion;
+        }
+
+        // swap is how far past the threshold the player who just took is,
+        //  supposing the piece they took with is lost.
+        //  It flips sign each time the other player would take back.
+        int swap = gain - threshold;
+        if (swap < 0) return false; // Even keeping the piece isn't enough
+        swap = values[on_square] - swap;
+        if (swap <= 0) return true; // Even losing the piece is enough
+
+        auto both = [this](Type type) { return pieces(White, type) | pieces(Black, type); };
+        BitBoard diagonal = both(Bishop) | both(Queen);
+        BitBoard straight = both(Rook) | both(Queen);
+        BitBoard attackers = attackers_to(to, occupied) & occupied;
+        Color color = !to_move();
+        // Whether the current player is ahead of the threshold if the exchange stops here
+        bool result = true;
+        while (true)
+        {
+            BitBoard mine = attackers & pieces(color);
+            if (mine.none()) break;
+            result = !result;
+            Type type = Pawn;
+            while ((mine & pieces(color, type)).none()) type = static_cast<Type>(type + 1);
+            // A king can only take if nothing can take it back
+            if (type == King)
+            {
+                return (attackers & pieces(!color)).any() ? !result : result;
+            }
+            // Stop once the player taking now stays on their side of the threshold
+            //  even after losing this piece, the other player won't take back
+            swap = values[type] - swap;
+            if (swap < static_cast<int>(result)) break;
+            occupied ^= BitBoard::square((mine & pieces(color, type)).lsb());
+            if (type == Pawn || type == Bishop || type == Queen)
+            {
+                attackers |= Attacks::bishop(to, occupied) & diagonal;
+            }
+            if (type == Rook || type == Queen)
+            {
+                attackers |= Attacks::rook(to, occupied) & straight;
+            }
+            attackers &= occupied;
+            color = !color;
+        }
+        return result;
+    }
+
+    BackAction State::apply_action(const Action& action)
+    {
+        LOG("apply_action");
+        Position from = action.from(), to = action.to();
+        Type promotion = action.promotion();
+        // Create a BackAction so that we can return to this state
+        Piece actor = piece_at(from);
+        BackAction back_action{action, Empty, static_cast<int16_t>(reversible), static_cast<int8_t>(double_moved_pawn),
+            captured, static_cast<int16_t>(since_pawn_or_capture), special, zobrist.hash};
+
+        // Record this position so we can check for draws later
+        keys[turn % keys.size()] = zobrist.hash;
+        reversible += 1;
+        since_pawn_or_capture += 1;
+        captured = false;
+        if (double_moved_pawn != -1)
+        {
+            zobrist.update_enpassant(double_moved_pawn % 8);
+            double_moved_pawn = -1;
         }
 
-        State::Square& from = at(action.from);
-        State::Square& to = at(action.to);
         // Special cases
-        if (action.promotion != Empty)
+        if (promotion != Empty)
         {
             // Promotion
-            if (from.piece->type == Pawn && action.to.rank == (from.piece->color == Black ? 7 : 0))
+            if (actor.type == Pawn && (to.rank == 0 || to.rank == 7))
             {
                 LOG("Promotion");
-                if (to.piece != nullptr)
+                if (at(to) != Empty)
                 {
-                    back_action.taken = *(to.piece);
-                    kill_piece(to.piece);
+                    back_action.taken = at(to);
+                    kill_piece(to);
                 }
-                Piece* piece = from.piece;
-                move_piece(action.from, action.to);
-                remove_piece(piece);
-                auto& v = pieces_by_color_and_type[piece->color][piece->type];
-                v.erase(std::find(v.begin(), v.end(), piece));
-                piece->type = action.promotion;
-                pieces_by_color_and_type[piece->color][piece->type].emplace_back(piece);
-                place_piece(piece, piece->pos);
+                remove_piece(from);
+                place_piece(Piece(to, promotion, actor.color));
                 since_pawn_or_capture = 0;
             }
             // Castling
-            else if (from.piece->type == King && std::abs(static_cast<int>(action.from.file - action.to.file)) == 2)
+            else if (actor.type == King)
             {
                 LOG("Castling");
-                at(action.from).piece->special = false;
-                move_piece(action.from, action.to);
-                Position rook_from(action.from.rank, action.to.file == 2 ? 0 : 7);
-                Position rook_to(action.from.rank, action.to.file == 2 ? 3 : 5);
-                // Record old rook state
-                back_action.taken = *(at(rook_from).piece);
+                move_piece(from, to);
+                Position rook_from(from.rank, to.file == 2 ? 0 : 7);
+                Position rook_to(from.rank, to.file == 2 ? 3 : 5);
                 // Move rook
-                at(rook_from).piece->special = false;
                 move_piece(rook_from, rook_to);
             }
             // En passant and double move
-            else if (from.piece->type == Pawn)
+            else if (actor.type == Pawn)
             {
-                if (action.promotion == Pawn) // Double move
+                if (promotion == Pawn) // Double move
                 {
-                    move_piece(action.from, action.to);
-                    double_moved_pawn = at(action.to).piece;
-                    at(action.to).piece->special = false;
+                    move_piece(from, to);
+                    double_moved_pawn = to.square();
+                    zobrist.update_enpassant(to.file);
                     since_pawn_or_capture = 0;
                 }
                 else // En passant
                 {
                     LOG("En passant");
-                    move_piece(action.from, action.to);
-                    // Record killed pawn
-                    Piece* piece = at(action.from.rank, action.to.file).piece;
-                    back_action.taken = *piece;
-                    // Kill pawn
-                    kill_piece(piece);
+                    move_piece(from, to);
+                    // Record and kill the pawn
+                    Position taken(from.rank, to.file);
+                    back_action.taken = Pawn;
+                    kill_piece(taken);
                 }
             }
         }
         // Normal move
         else
         {
-            if (to.piece != nullptr)
+            if (at(to) != Empty)
             {
-                back_action.taken = *(to.piece);
-                kill_piece(to.piece);
+                back_action.taken = at(to);
+                kill_piece(to);
             }
-            move_piece(action.from, action.to);
-            to.piece->special = false;
-            if (to.piece->type == Pawn)
+            move_piece(from, to);
+            if (actor.type == Pawn)
             {
                 since_pawn_or_capture = 0;
             }
         }
 
-        // Add the moves to en-passant the currently double-moved pawn
-        if (double_moved_pawn != nullptr)
+        // Whatever moved from or was taken on these squares can no longer castle
+        BitBoard touched = BitBoard::square(action.from_square()) | BitBoard::square(action.to_square());
+        if ((special & touched).any())
         {
-            Position adjacent = double_moved_pawn->pos + Position(0, 1);
-            if (inside(adjacent) && at(adjacent).piece != nullptr)
+            for (Color color : {White, Black})
             {
-                at(adjacent).piece->moves.clear();
-                possible_piece_moves(at(adjacent).piece, at(adjacent).piece->moves);
+                zobrist.update_castling(color, castling_state(color));
             }
-            adjacent += Position(0, -2);
-            if (inside(adjacent) && at(adjacent).piece != nullptr)
+            special &= ~touched;
+            for (Color color : {White, Black})
             {
-                at(adjacent).piece->moves.clear();
-                possible_piece_moves(at(adjacent).piece, at(adjacent).piece->moves);
+                zobrist.update_castling(color, castling_state(color));
             }
         }
 
+        // Nothing from before a pawn move or a capture can come back
+        if (since_pawn_or_capture == 0) reversible = 0;
+
+        zobrist.toggle_color(actor.color);
+        zobrist.toggle_color(!actor.color);
         turn += 1;
         return back_action;
     }
 
-    void State::apply_back_action(const BackAction& action)
+    void State::apply_back_action(const BackAction& back_action)
     {
         LOG("apply_back_action");
-        Piece* old_double_moved_pawn = (action.double_moved_pawn_id == -1 ? nullptr :
-                &(pieces[action.double_moved_pawn_id]));
-
-        // Remove the moves to en-passant the currently double-moved pawn
-        if (double_moved_pawn != nullptr)
+        Position from = back_action.action.from(), to = back_action.action.to();
+        Type promotion = back_action.action.promotion();
+        turn -= 1;
+        Color color = to_move();
+        // Castling, the rook goes back too
+        if (promotion == King && at(to) == King)
         {
-            Position adjacent = double_moved_pawn->pos + Position(0, 1);
-            // Reset double_moved_pawn so that this actually removes moves
-            double_moved_pawn = nullptr;
-            // Remove moves
-            if (inside(adjacent) && at(adjacent).piece != nullptr)
-            {
-                at(adjacent).piece->moves.clear();
-                possible_piece_moves(at(adjacent).piece, at(adjacent).piece->moves);
-            }
-            adjacent += Position(0, -2);
-            if (inside(adjacent) && at(adjacent).piece != nullptr)
-            {
-                at(adjacent).piece->moves.clear();
-                possible_piece_moves(at(adjacent).piece, at(adjacent).piece->moves);
-            }
+            move_piece(to, from);
+            move_piece(Position(to.rank, to.file == 2 ? 3 : 5), Position(to.rank, to.file == 2 ? 0 : 7));
         }
-
-        Piece* piece = &(pieces[action.actor.id]);
-
-        // Move attacking piece back
-        if (action.type != Empty)
+        // En passant, the taken pawn was beside where ours ended up
+        else if (promotion == King)
         {
-            // Promotion
-            if (action.actor.type != piece->type)
-            {
-                remove_piece(piece);
-
-                auto& v = pieces_by_color_and_type[piece->color][piece->type];
-                v.erase(std::find(v.begin(), v.end(), piece));
-                *piece = action.actor;
-                pieces_by_color_and_type[piece->color][piece->type].emplace_back(piece);
-
-                if (action.taken.id != -1) // If a piece was taken
-                {
-                    Piece* taken = &(pieces[action.taken.id]);
-                    *taken = action.taken;
-                    pieces_by_color_and_type[taken->color][taken->type].emplace_back(taken);
-                    place_piece(taken, taken->pos);
-                }
-                place_piece(piece, piece->pos);
-            }
-            // Castleing
-            else if (action.type == King && piece->type == King)
-            {
-                // Return king
-                remove_piece(piece);
-                *piece = action.actor;
-                place_piece(piece, piece->pos);
-                // Return rook
-                Piece* taken = &(pieces[action.taken.id]);
-                remove_piece(taken);
-                *taken = action.taken;
-                place_piece(taken, taken->pos);
-            }
-            // En passant and double move
-            else if (action.actor.type == Pawn)
-            {
-                if (action.type == Pawn) // Double move
-                {
-                    remove_piece(piece);
-                    *piece = action.actor;
-                    place_piece(piece, piece->pos);
-                }
-                else // En passant
-                {
-                    remove_piece(piece);
-                    *piece = action.actor;
-                    place_piece(piece, piece->pos);
-                    // Restore taken pawn
-                    Piece* taken = &(pieces[action.taken.id]);
-                    *taken = action.taken;
-                    pieces_by_color_and_type[taken->color][taken->type].emplace_back(taken);
-                    place_piece(taken, taken->pos);
-                }
-            }
+            move_piece(to, from);
+            place_piece(Piece(Position(from.rank, to.file), Pawn, !color));
         }
+        // Everything else puts the actor back and then the taken piece (if one was taken)
         else
-        // Normal move
         {
-            remove_piece(piece);
-            *piece = action.actor;
-            if (action.taken.id != -1) // If a piece was taken
+            // Promoted pieces go back to being pawns
+            if (promotion != Empty && promotion != Pawn)
             {
-                Piece* taken = &(pieces[action.taken.id]);
-                *taken = action.taken;
-                pieces_by_color_and_type[taken->color][taken->type].emplace_back(taken);
-                place_piece(taken, taken->pos);
+                remove_piece(to);
+                place_piece(Piece(from, Pawn, color));
             }
-            place_piece(piece, piece->pos);
-        }
-
-        // Update double_moved_pawn so that moves are added
-        double_moved_pawn = old_double_moved_pawn;
-        // Add the moves to en-passant the previously double-moved pawn
-        if (double_moved_pawn != nullptr)
-        {
-            Position adjacent = double_moved_pawn->pos + Position(0, 1);
-            if (inside(adjacent) && at(adjacent).piece != nullptr)
+            else
             {
-                at(adjacent).piece->moves.clear();
-                possible_piece_moves(at(adjacent).piece, at(adjacent).piece->moves);
+                move_piece(to, from);
             }
-            adjacent += Position(0, -2);
-            if (inside(adjacent) && at(adjacent).piece != nullptr)
+            if (back_action.taken != Empty)
             {
-                at(adjacent).piece->moves.clear();
-                possible_piece_moves(at(adjacent).piece, at(adjacent).piece->moves);
+                place_piece(Piece(to, back_action.taken, !color));
             }
         }
 
         // Restore state variables
-        since_pawn_or_capture = action.since_pawn_or_capture;
-        captured = action.captured;
-        uint64_t null_history = 0;
-        // Add old state
-        if (action.old_action != null_history)
-        {
-            history.push_front(action.old_action);
-        }
-        else // Remove a state, we are near the beginning
+        double_moved_pawn = back_action.double_moved_pawn;
+        special = back_action.special;
+        zobrist.hash = back_action.hash;
+        since_pawn_or_capture = back_action.since_pawn_or_capture;
+        captured = back_action.captured;
+        // The keys before this state were left alone
+        reversible = back_action.reversible;
+    }
+
+    BackAction State::apply_null_action()
+    {
+        LOG("apply_null_action");
+        Color color = to_move();
+        BackAction back_action{Action(), Empty, static_cast<int16_t>(reversible), static_cast<int8_t>(double_moved_pawn),
+            captured, static_cast<int16_t>(since_pawn_or_capture), special, zobrist.hash};
+        since_pawn_or_capture += 1;
+        reversible = 0;
+        captured = false;
+        // The chance to take en passant is lost
+        if (double_moved_pawn != -1)
         {
-            history.pop_back();
+            zobrist.update_enpassant(double_moved_pawn % 8);
+            double_moved_pawn = -1;
         }
+        zobrist.toggle_color(color);
+        zobrist.toggle_color(!color);
+        turn += 1;
+        return back_action;
+    }
+
+    void State::apply_null_back_action(const BackAction& back_action)
+    {
+        LOG("apply_null_back_action");
         turn -= 1;
+        double_moved_pawn = back_action.double_moved_pawn;
+        zobrist.hash = back_action.hash;
+        since_pawn_or_capture = back_action.since_pawn_or_capture;
+        captured = back_action.captured;
+        reversible = back_action.reversible;
     }
 
-    std::vector<Action> State::generate_actions() const
+    MoveList State::generate_actions() const
     {
         LOG("generate_actions");
-        /*
-        std::vector<Action> actions;
-        for (auto&& piece : pieces)
+        MoveList actions;
+        generate_actions(AllMoves, restrictions(to_move()), actions);
+        return actions;
+    }
+
+    void State::generate_actions(MoveKind kind, const Restrictions& r, MoveList& actions) const
+    {
+        Color color = to_move();
+        // Only the king can move out of a double check
+        if (!r.checkers.several())
         {
-            if (piece.alive && piece.color == turn % 2)
+            possible_pawn_moves(color, r, kind, actions);
+            for (auto type : {Bishop, Knight, Rook, Queen})
             {
-                possible_piece_moves(&piece, actions);
+                possible_piece_moves(color, type, r, kind, actions);
             }
         }
-        */
-        std::vector<Action> actions;
-        auto inserter = std::back_inserter(actions);
-        for (auto&& piece : pieces)
+        possible_king_moves(color, r, kind, actions);
+    }
+
+    bool State::is_legal(const Action& action, const Restrictions& r) const
+    {
+        Color color = to_move();
+        int from = action.from_square();
+        if (!pieces(color).at(from)) return false;
+        // Generate the moves for this type of piece only
+        MoveList actions;
+        Type type = squares[from];
+        if (type == King)
         {
-            if (piece.alive && piece.color == turn % 2)
-            {
-                std::copy(piece.moves.begin(), piece.moves.end(), inserter);
-            }
+            possible_king_moves(color, r, AllMoves, actions);
         }
-        /*
-        std::set<Action> a(actions.begin(), actions.end());
-        std::set<Action> b(actions2.begin(), actions2.end());
-        if (a != b)
+        else if (!r.checkers.several())
         {
-            std::cerr << "Moves not the same" << std::endl;
-            for (auto&& action : actions)
-            {
-                std::cerr << action << std::endl;
-            }
-            std::cerr << "actions2:" << std::endl;
-            for (auto&& action : actions2)
-            {
-                std::cerr << action << std::endl;
-            }
-            std::cerr << "State: " << *this;
+            if (type == Pawn) possible_pawn_moves(color, r, AllMoves, actions);
+            else possible_piece_moves(color, type, r, AllMoves, actions);
         }
-        */
+        return std::find(actions.begin(), actions.end(), action) != actions.end();
+    }
+
+    MoveList State::generate_filtered_actions() const
+    {
+        LOG("generate_filtered_actions");
+        Color color = to_move();
+        Restrictions r = unrestricted();
+        MoveList actions;
+        possible_pawn_moves(color, r, AllMoves, actions);
+        for (auto type : {Bishop, Knight, Rook, Queen})
+        {
+            possible_piece_moves(color, type, r, AllMoves, actions);
+        }
+        possible_king_moves(color, r, AllMoves, actions);
 
         // Remove actions which would put the moving player into check
-        std::vector<Action> safe_actions;
-        safe_actions.reserve(actions.size());
-        std::remove_copy_if(actions.begin(), actions.end(), std::back_inserter(safe_actions),
-                [this](const Action& action){
+        actions.truncate(std::remove_if(actions.begin(), actions.end(),
+                [this, color](const Action& action){
                     LOG("generate_actions: lambda");
                     State* state = const_cast<State*>(this); // Back action should revert all changes to the state
                     auto back_action = state->apply_action(action);
-                    auto checked = state->is_in_check(((state->turn - 1) % 2) ? Black : White);
+                    auto checked = state->is_in_check(color);
                     state->apply_back_action(back_action);
                     return checked;
-                });
-        return safe_actions;
+                }));
+        return actions;
     }
 
     bool State::is_in_check(Color color) const
     {
-        return at(pieces_by_color_and_type[color][King][0]->pos).checked_by_color(!color);
+        BitBoard king = pieces(color, King);
+        return king.any() && is_attacked(king.lsb(), !color);
     }
 
     int State::material(Color color) const
@@ -560,51 +620,30 @@ namespace Skaia
         int h = 0;
         for (auto& type : types)
         {
-            h += type.second * p[type.first].size();
+            h += type.second * p[type.first].count();
         }
         // Extra bonuses for having pairs
-        if (p[Rook].size() >= 2) h += 1;
-        if (p[Bishop].size() >= 2) h += 1;
+        if (p[Rook].count() >= 2) h += 1;
+        if (p[Bishop].count() >= 2) h += 1;
         // Extra bonus for having multiple long-range pieces
-        if (p[Rook].size() + p[Bishop].size() + p[Queen].size() >= 3) h += 1;
+        if ((p[Rook] | p[Bishop] | p[Queen]).count() >= 3) h += 1;
         return h;
     }
 
     int State::count_net_checks(Color color) const
     {
-        auto count = [&](const Square& square, Color color) {
-            if (color == Black)
-            {
-                return (square.checks >> 16).count();
-            }
-            else
-            {
-                return (square.checks << 16).count();
-            }
-        };
+        BitBoard occupied = this->occupied();
         int checks = 0;
-        for (auto& type : std::array<Type, 6>{{Pawn, Bishop, Knight, Rook, Queen, King}})
+        for (int square : pieces(color))
         {
-            for (Piece* piece : pieces_by_color_and_type[color][type])
-            {
-                checks += count(at(piece->pos), color) - count(at(piece->pos), !color);
-            }
+            BitBoard attackers = attackers_to(square, occupied);
+            checks += (attackers & pieces(!color)).count() - (attackers & pieces(color)).count();
         }
         return checks;
     }
-    
+
     int State::count_net_check_values(Color color) const
     {
-        // OPTIMIZE: Cache all dis
-        static const std::array<int, 7> protect_value = {
-            0, // Buffer space
-            1, // Pawn
-            3, // Bishop
-            3, // Knight
-            5, // Rook
-            9, // Queen
-            0  // King
-        };
         static const std::array<int, 7> check_value = {
             0, // Buffer space
             6, // Pawn
@@ -614,31 +653,17 @@ namespace Skaia
             2, // Queen
             1  // King
         };
+        BitBoard occupied = this->occupied();
         int h = 0;
-        for (auto& type : std::array<Type, 6>{{Pawn, Bishop, Knight, Rook, Queen, King}})
+        for (int square : pieces(color))
         {
-            int piece_h = 0;
-            for (Piece* piece : pieces_by_color_and_type[color][type])
+            BitBoard attackers = attackers_to(square, occupied);
+            if (attackers.none()) continue;
+            for (auto type : {Pawn, Bishop, Knight, Rook, Queen, King})
             {
-                auto &checks = at(piece->pos).checks;
-                for (int i = 0; i < checks.size(); ++i)
-                {
-                    if (checks[i])
-                    {
-                        auto &piece = pieces[i];
-                        if (piece.color == color)
-                        {
-                            h += check_value[piece.type];
-                        }
-                        else
-                        {
-                            h -= check_value[piece.type];
-                        }
-                    }
-                }
+                h += check_value[type] * ((attackers & pieces(color, type)).count() -
+                        (attackers & pieces(!color, type)).count());
             }
-            piece_h *= protect_value[type];
-            h += piece_h;
         }
         return h;
     }
@@ -647,60 +672,57 @@ namespace Skaia
     {
         int h = 0;
         int starting_rank = color == White ? 6 : 1;
-        for (auto& piece : pieces_by_color_and_type[color][Pawn])
+        for (int rank = 0; rank < 8; ++rank)
         {
-            h += abs(piece->pos.rank - starting_rank);
+            h += abs(rank - starting_rank) * (pieces(color, Pawn) & BitBoard::rank_mask(rank)).count();
         }
         return h;
     }
 
     int State::count_piece_moves(Color color) const
     {
+        BitBoard occupied = this->occupied();
+        BitBoard targets = ~pieces(color);
         int h = 0;
-        int i = (color ? 16 : 0); // First 16 pieces are white's next 16 are black's
-        for (auto c = 0u; c < 16; ++c)
+        for (auto type : {Bishop, Knight, Rook, Queen, King})
         {
-            if (pieces[i].alive)
+            for (int square : pieces(color, type))
             {
-                h += pieces[i].moves.size();
+                h += (Attacks::piece(type, color, square, occupied) & targets).count();
             }
-            i += 1;
         }
+        // Pawns move forward into empty squares and attack diagonally
+        int direction = color ? 1 : -1;
+        BitBoard pawns = pieces(color, Pawn);
+        BitBoard single = pawns.shifted(direction, 0) & ~occupied;
+        h += single.count();
+        h += ((single & BitBoard::rank_mask(color ? 2 : 5)).shifted(direction, 0) & ~occupied).count();
+        h += (pawns.shifted(direction, -1) & pieces(!color)).count();
+        h += (pawns.shifted(direction, 1) & pieces(!color)).count();
         return h;
     }
 
+    int State::count_king_moves(Color color) const
+    {
+        BitBoard king = pieces(color, King);
+        if (king.none()) return 0;
+        return (Attacks::king(king.lsb()) & ~pieces(color)).count();
+    }
+
     SimpleSmallState State::to_simple() const
     {
         LOG("to_simple");
-        auto convert_piece = [&](const Piece* piece) {
-            return piece == nullptr ? 0 : (
-                    static_cast<uint64_t>(piece->type) +
-                    (static_cast<uint64_t>(piece->color) << 3));
-        };
-        auto convert_two_rows = [&](int start) -> uint64_t {
-            return
-                (convert_piece(squares[start++].piece) << 0 ) +
-                (convert_piece(squares[start++].piece) << 4 ) +
-                (convert_piece(squares[start++].piece) << 8 ) +
-                (convert_piece(squares[start++].piece) << 12) +
-                (convert_piece(squares[start++].piece) << 16) +
-                (convert_piece(squares[start++].piece) << 20) +
-                (convert_piece(squares[start++].piece) << 24) +
-                (convert_piece(squares[start++].piece) << 28) +
-                (convert_piece(squares[start++].piece) << 32) +
-                (convert_piece(squares[start++].piece) << 36) +
-                (convert_piece(squares[start++].piece) << 40) +
-                (convert_piece(squares[start++].piece) << 44) +
-                (convert_piece(squares[start++].piece) << 48) +
-                (convert_piece(squares[start++].piece) << 52) +
-                (convert_piece(squares[start++].piece) << 56) +
-                (convert_piece(squares[start++].piece) << 60);
+        auto convert_square = [&](int square) -> uint64_t {
+            return squares[square] == Empty ? 0 : (
+                    static_cast<uint64_t>(squares[square]) +
+                    (static_cast<uint64_t>(color_at(square)) << 3));
         };
-        return SimpleSmallState{{{convert_two_rows(0),
-            convert_two_rows(16),
-            convert_two_rows(32),
-            convert_two_rows(48),
-        }}};
+        SimpleSmallState simple{{{0, 0, 0, 0}}};
+        for (int square = 0; square < 64; ++square)
+        {
+            simple.data[square / 16] |= convert_square(square) << ((square % 16) * 4);
+        }
+        return simple;
     }
 
     // Testing functions
@@ -713,81 +735,29 @@ namespace Skaia
             }
             return cond;
         };
-        // Convenience function for comparing pointers which may be null
-        auto cmp_ptr = [](Piece* a, Piece* b) {
-            if (a == nullptr) return b == nullptr;
-            if (b == nullptr) return a == nullptr;
-            return a->id == b->id;
-        };
-        // Compare pieces_by_color_and_type
-        for (Color color : std::vector<Color>{White, Black})
-        {
-            for (Type type : std::vector<Type>{Pawn, Bishop, Knight, Rook, Queen, King})
+        // Only the keys that can still repeat are compared, the rest are left over
+        auto same_keys = [this, &rhs]() {
+            for (int i = std::min(reversible, repetition_window); i > 0; --i)
             {
-                if (pieces_by_color_and_type[color][type].size() !=
-                        rhs.pieces_by_color_and_type[color][type].size())
-                {
-                    std::cerr << "Assertion: pieces_by_color_and_type.size failed" << std::endl;
-                    return false;
-                }
-                std::set<int> lhs_set, rhs_set;
-                for (int i = 0; i < pieces_by_color_and_type[color][type].size(); ++i)
-                {
-                    lhs_set.insert(pieces_by_color_and_type[color][type][i]->id);
-                    rhs_set.insert(rhs.pieces_by_color_and_type[color][type][i]->id);
-                }
-                if (lhs_set != rhs_set)
-                {
-                    std::cerr << "Assertion: pieces_by_color_and_type failed" << std::endl;
-                    return false;
-                }
+                if (key(i) != rhs.key(i)) return false;
             }
-        }
-        // Compare the rest of the stuff
+            return true;
+        };
         return
             check(turn == rhs.turn, "turn") &&
-            check(pieces == rhs.pieces, "pieces") &&
+            check(pieces_by_color_and_type == rhs.pieces_by_color_and_type, "pieces_by_color_and_type") &&
             check(squares == rhs.squares, "squares") &&
-            check(cmp_ptr(double_moved_pawn, rhs.double_moved_pawn), "double") &&
-            check(history == rhs.history, "history") &&
+            check(special == rhs.special, "special") &&
+            check(zobrist.hash == rhs.zobrist.hash, "zobrist") &&
+            check(double_moved_pawn == rhs.double_moved_pawn, "double") &&
+            check(reversible == rhs.reversible && same_keys(), "keys") &&
             check(since_pawn_or_capture == rhs.since_pawn_or_capture, "since") &&
             check(captured == rhs.captured, "capture");
     }
 
-    bool State::Square::operator==(const Square& rhs) const
-    {
-        // Convenience function for comparing pointers which may be null
-        auto cmp_ptr = [](Piece* a, Piece* b) {
-            if (a == nullptr) return b == nullptr;
-            if (b == nullptr) return a == nullptr;
-            return a->id == b->id;
-        };
-        return
-            cmp_ptr(piece, rhs.piece) &&
-            checks == rhs.checks;
-    }
-
     void State::print_debug_info(std::ostream& out) const
     {
         out << "Turn: " << turn << std::endl;
-        out << "Pieces: [" << std::endl;
-        for (auto &piece : pieces)
-        {
-            out << piece << "," << std::endl;
-        }
-        out << "]" << std::endl;
-        out << "Squares: [" << std::endl;
-        for (auto rank = 0u; rank < 8; ++rank)
-        {
-            for (auto file = 0u; file < 8; ++file)
-            {
-                out << (at(rank, file).piece == nullptr ? -1 : at(rank, file).piece->id);
-                out << ":" << std::hex << std::setw(sizeof(unsigned long) * 2) <<
-                    std::setfill('0') << at(rank, file).checks.to_ulong() <<
-                    std::dec << std::setw(0) << std::setfill(' ') << " ";
-            }
-            out << std::endl;
-        }
         out << "pieces_by_color_and_type: [" << std::endl;
         for (auto &color : std::vector<Color>{White, Black})
         {
@@ -795,27 +765,34 @@ namespace Skaia
             for (auto &type : std::vector<Type>{Pawn, Bishop, Knight, Rook, Queen, King})
             {
                 out << "    " << type_from_skaia(type) << " [";
-                for (auto &piece :  pieces_by_color_and_type[color][type])
+                for (int square : pieces(color, type))
                 {
-                    out << " " << piece->id;
+                    out << " " << Position::from_square(square);
                 }
                 out << " ]" << std::endl;
             }
         }
         out << "]" << std::endl;
-        if (double_moved_pawn == nullptr)
+        out << "Special: [";
+        for (int square : special)
+        {
+            out << " " << Position::from_square(square);
+        }
+        out << " ]" << std::endl;
+        if (double_moved_pawn == -1)
             out << "Double moved pawn: None" << std::endl;
         else
         {
-            out << "Double moved pawn: " << double_moved_pawn->id << " at " << double_moved_pawn->pos << std::endl;
+            out << "Double moved pawn: " << Position::from_square(double_moved_pawn) << std::endl;
         }
-        out << "History: [";
-        for (auto &small : history)
+        out << "Keys: [" << std::hex;
+        for (int i = std::min(reversible, repetition_window); i > 0; --i)
         {
-            out << small << ", ";
+            out << key(i) << ", ";
         }
-        out << "]";
+        out << std::dec << "]";
         out << std::endl << "since_pawn_or_capture: " << since_pawn_or_capture << std::endl;
+        out << "Zobrist: " << std::hex << zobrist.hash << std::dec << std::endl;
     }
 }
 
@@ -826,12 +803,12 @@ std::ostream& operator<<(std::ostream& out, const Skaia::State& state)
     {
         for (int file = 0; file < 8; ++file)
         {
-            Skaia::Piece* piece = state.at(rank, file).piece;
+            Skaia::Type type = state.at(rank, file);
             char symbol = '.';
-            if (piece != nullptr)
+            if (type != Skaia::Empty)
             {
-                symbol = type_chars[piece->type];
-                if (piece->color) symbol -= ('a' - 'A');
+                symbol = type_chars[type];
+                if (state.color_at(rank * 8 + file)) symbol -= ('a' - 'A');
             }
             out << symbol << " ";
         }
@@ -839,4 +816,3 @@ std::ostream& operator<<(std::ostream& out, const Skaia::State& state)
     }
     return out;
 }
-
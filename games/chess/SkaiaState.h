@@ -2,19 +2,22 @@
 
 // A class representing a board state along with functions for interacting with that state.
 
-#include <bitset>
 #include <array>
+#include <vector>
 #include <iostream>
 #include <iomanip>
 #include <cstdint>
-
-#include <boost/circular_buffer.hpp>
+#include <string>
+#include <type_traits>
 
 #include "SkaiaAction.h"
+#include "SkaiaMoveList.h"
 #include "SkaiaBackAction.h"
 #include "SkaiaSimpleSmallState.h"
 #include "SkaiaPiece.h"
+#include "SkaiaAttacks.h"
 #include "Skaia.h"
+#include "BitBoard.h"
 
 #include "Zobrist.h"
 
@@ -23,48 +26,62 @@ namespace Skaia
     class State
     {
         public:
-            // A square tile on the chess board
-            struct Square
-            {
-                Piece* piece;
-                std::bitset<32> checks;
-
-                Square() : piece(nullptr), checks() {}
-                Square(Piece* piece) : piece(piece) {}
-                Square(Piece* piece, const std::bitset<32>& checks) : piece(piece), checks(checks) {}
-
-                bool checked_by_color(Color color) const
-                {
-                    return checks.to_ulong() & (color ? 0x0000ffff : 0xffff0000);
-                }
-
-                // For testing
-                bool operator==(const Square& rhs) const;
-            };
-
             size_t turn;
-            std::array<Piece, 32> pieces;
-            std::array<Square, 8 * 8> squares;
-            std::array<std::array<std::vector<Piece*>, NumberOfTypes>, 2> pieces_by_color_and_type;
-            Piece* double_moved_pawn; // Points to the one pawn that is capturable by en-passant, or nullptr
-            boost::circular_buffer<uint64_t> history; // For detecting draws by repeat
+            // One BitBoard per color and type of piece,
+            //  the Empty slot holds every piece of that color.
+            std::array<std::array<BitBoard, NumberOfTypes>, 2> pieces_by_color_and_type;
+            std::array<Type, 8 * 8> squares; // The type of piece on each square, or Empty
+            BitBoard special; // Squares holding a king or rook that has never moved
+            int double_moved_pawn; // Square of the one pawn that is capturable by en-passant, or -1
+            // Searches never look further than this many ply past their root
+            static const int max_ply = 128;
+            // Repeats are looked for this many plies back at most, any further and
+            //  since_pawn_or_capture has already made it a draw
+            static const int repetition_window = 100;
+            // Zobrist hashes of earlier positions for detecting draws by repeat, the one
+            //  from turn t is at keys[t % keys.size()]. Only the last reversible of them are kept up to date.
+            // There is room for a whole window behind the root of a search and every ply of
+            //  the search, so undoing actions never needs a key back that a deeper one overwrote.
+            std::array<uint64_t, repetition_window + max_ply> keys;
+            int reversible; // Plies since the last pawn move, capture or null action, nothing before it can repeat
             int since_pawn_or_capture; // For detecting draws by no pawn move or piece captured
             bool captured; // Whether a piece was captured on the last move
-            //Zobrist zobrist; // Hash board state
+            Zobrist zobrist; // Hash board state
 
             // Default constructor initializes state to the beginning of a normal chess game
             State();
-            State(const State& source);
+
+            // Set up any position from Forsyth-Edwards Notation,
+            //  the move counters may be left off. Throws std::invalid_argument if
+            //  the piece placement or side to move can't be read.
+            static State from_fen(const std::string& fen);
+            // Describe this state in Forsyth-Edwards Notation
+            std::string to_fen() const;
 
             // Generate a list of valid moves for the current player
-            std::vector<Action> generate_actions() const;
+            MoveList generate_actions() const;
+            // Same as generate_actions, but generates pseudo-legal moves and then
+            //  throws out the ones that leave the king in check by applying them.
+            // This is much slower, it is kept to check generate_actions against.
+            MoveList generate_filtered_actions() const;
 
             // Chenge the current state by applying an action
             BackAction apply_action(const Action& action);
-            void apply_back_action(const BackAction& action);
-
-            // Detect draw
-            bool draw() const;
+            void apply_back_action(const BackAction& back_action);
+            // Pass the turn without moving, for null move pruning.
+            //  Positions before the pass don't count as repeats, and it must be undone with apply_null_back_action.
+            BackAction apply_null_action();
+            void apply_null_back_action(const BackAction& back_action);
+
+            // Detect draw by the fifty move rule or by repetition. Repeating a position from
+            //  the last ply plies (the ones inside a search) is a draw the first time,
+            //  older positions have to repeat twice like the rules say.
+            bool draw(int ply = 0) const;
+            // Whether the player to move has a reversible action back to a position from the last ply plies,
+            //  so that they can draw by repetition. Found in Zobrist's cuckoo tables without generating actions.
+            bool upcoming_repetition(int ply) const;
+            // The hash of the position plies_ago plies before this one, which must be at most reversible and repetition_window
+            uint64_t key(int plies_ago) const { return keys[(turn - plies_ago) % keys.size()]; }
 
             // Detect quiescent state
             bool quiescent() const;
@@ -75,110 +92,80 @@ namespace Skaia
             int count_net_check_values(Color color) const;
             int count_pawn_advancement(Color color) const;
             int count_piece_moves(Color color) const;
+            int count_king_moves(Color color) const;
 
             // Access a square
-            const Square& at(int rank, int file) const;
-            const Square& at(const Position& pos) const;
-            Square& at(int rank, int file);
-            Square& at(const Position& pos);
+            Type at(int rank, int file) const;
+            Type at(const Position& pos) const;
+            Color color_at(int square) const;
+            Piece piece_at(const Position& pos) const;
+
+            // Shorthands for the BitBoards
+            BitBoard pieces(Color color) const { return pieces_by_color_and_type[color][Empty]; }
+            BitBoard pieces(Color color, Type type) const { return pieces_by_color_and_type[color][type]; }
+            BitBoard occupied() const { return pieces(White) | pieces(Black); }
+            Color to_move() const { return turn % 2 ? Black : White; }
+
+            // Which castles are still possible for a color, 0/1/2/3 for None/King/Queen/Both side
+            int castling_state(Color color) const;
 
         public:
             // Check if a position is on the board
             static bool inside(int rank, int file) { return 0 <= rank && rank < 8 && 0 <= file && file < 8; }
             static bool inside(const Position& pos) { return inside(pos.rank, pos.file); }
 
-            // Check if a position is good for a piece to move to
-            bool empty(const Position& pos) const;
-            bool canTake(const Piece* piece, const Position& pos) const; // Position is empty or contains an enemy piece
-            bool canKill(const Piece* piece, const Position& pos) const; // Position contains an enemy piece
-
-            // Ray-casting functions
-            // These functions apply a func to all the tiles starting at position + delta and
-            //  moving the direction of delta until the given piece cannot reach the
-            //  position in the current turn.
-            // For example, if a queen at position (0,0) is used as the starting piece,
-            //  and (1,0) is given as the delta, then func() is called with all positions
-            //  from (1,0) to (7,0).
-            // If an enemy pawn were at position (5,0) then only positions (1,0) to (5,0)
-            //  would be considered.
-            // If a friendly pawn were at position (5,0) then only positions (1,0) to (4,0)
-            //  would be considered.
-            template<typename F> void ray_action(const Piece* piece, const Position& delta, F func)
-            {
-                Position new_pos = piece->pos;
-                while (true)
-                {
-                    new_pos += delta;
-                    if (!canTake(piece, new_pos)) break;
-                    func(new_pos);
-                    if (!empty(new_pos)) break;
-                }
-            }
-            template<typename F> void ray_action_const(const Piece* piece, const Position& delta, F func) const
-            {
-                if (delta.rank == 0 && delta.file == 0)
-                {
-                    std::cerr << "No delta!" << std::endl;
-                    return;
-                }
-                Position new_pos = piece->pos;
-                while (true)
-                {
-                    new_pos += delta;
-                    if (!canTake(piece, new_pos)) break;
-                    func(new_pos);
-                    if (!empty(new_pos)) break;
-                }
-            }
-            // This version of raw_action considers all pieces to be enemy pieces, and so
-            //  will apply func() to all positions including the first encountered piece,
-            //  whether friend or foe.
-            template<typename F> void ray_action(const Position& from, const Position& delta, F func)
-            {
-                if (delta.rank == 0 && delta.file == 0)
-                {
-                    std::cerr << "No delta!" << std::endl;
-                    return;
-                }
-                Position new_pos = from;
-                while (true)
-                {
-                    new_pos += delta;
-                    if (!inside(new_pos)) break;
-                    func(new_pos);
-                    if (!empty(new_pos)) break;
-                }
-            }
-
-            // Functions for setting check
-            void check_piece(const Piece* piece, bool check);
-            void check_ray(const Piece* piece, const Position& delta, bool check);
-            void check_pos(const Piece* piece, const Position& pos, bool check);
-            void check_pawn(const Piece* piece, bool check);
-            void check_bishop(const Piece* piece, bool check);
-            void check_rook(const Piece* piece, bool check);
-            void check_knight(const Piece* piece, bool check);
-            void check_king(const Piece* piece, bool check);
+            // Functions for finding attacks
+            // All pieces of both colors which attack the given square
+            BitBoard attackers_to(int square, BitBoard occupied) const;
+            bool is_attacked(int square, Color by) const;
+            bool is_attacked(int square, Color by, BitBoard occupied) const;
+            // Static exchange evaluation: the material (in pawns, like material()) the current player
+            //  comes out ahead if both players keep recapturing on the action's target square
+            //  with their least valuable piece, each stopping whenever it would lose more.
+            // Sliders lined up behind a capturing piece join in, but pins are ignored.
+            int see(const Action& action) const;
+            // Whether see(action) >= threshold, stopping as soon as the exchange can't cross it
+            bool see_ge(const Action& action, int threshold) const;
 
             // Functions for moving pieces around the board
-            void place_piece(Piece* piece, const Position& pos);
-            void remove_piece(Piece* piece); // Temporarily take the piece off the board
-            void kill_piece(Piece* piece); // Make it dead
+            // These keep squares and the BitBoards in sync
+            void place_piece(const Piece& piece);
+            void remove_piece(const Position& pos); // Temporarily take the piece off the board
+            void kill_piece(const Position& pos); // Make it dead
             void move_piece(const Position& from, const Position& to);
 
             // Functions for generating moves
             bool is_in_check(Color color) const;
-            // These functions all take a vector<Action> by reference and add moves this vector
+
+            // Limits on where pieces can move so that their king is not left in check,
+            //  these are found once per state before generating moves
+            struct Restrictions
+            {
+                int king; // Square of the king being protected, or -1 to allow pseudo-legal moves
+                BitBoard checkers; // Enemy pieces giving check
+                BitBoard check_mask; // Other pieces must move here to capture or block a single checker
+                BitBoard pinned; // Pieces which may only move along the line through them and their king
+            };
+            Restrictions restrictions(Color color) const;
+            static Restrictions unrestricted();
+
+            // Which of the moves to generate. Captures also has every promotion
+            //  and en passant, so Captures and Quiets together are all of the moves.
+            enum MoveKind {Captures, Quiets, AllMoves};
+            // Adds the current player's moves of one kind, r must be restrictions(to_move())
+            void generate_actions(MoveKind kind, const Restrictions& r, MoveList& actions) const;
+            // Whether the current player can make the action, for checking
+            //  actions that came from somewhere other than the generators
+            bool is_legal(const Action& action, const Restrictions& r) const;
+
+            // These functions all take a MoveList by reference and add moves to it
             // TODO: Make them take an output iterator (such as a back_inserter)
-            void try_take(const Piece* piece, const Position& to, std::vector<Action>& actions) const;
-            void possible_piece_moves(const Piece* piece, std::vector<Action>& actions) const;
-            void pawn_move_with_promotions(const Piece* piece, const Position& to, std::vector<Action>& actions) const;
-            void possible_pawn_moves(const Piece* piece, std::vector<Action>& actions) const;
-            void line_moves(const Piece* piece, const Position& delta, std::vector<Action>& actions) const;
-            void possible_bishop_moves(const Piece* piece, std::vector<Action>& actions) const;
-            void possible_rook_moves(const Piece* piece, std::vector<Action>& actions) const;
-            void possible_knight_moves(const Piece* piece, std::vector<Action>& actions) const;
-            void possible_king_moves(const Piece* piece, std::vector<Action>& actions) const;
+            void add_moves(int from, BitBoard targets, MoveList& actions) const;
+            void pawn_move_with_promotions(int from, int to, MoveList& actions) const;
+            BitBoard targets(Color color, MoveKind kind) const; // The squares moves of a kind may land on
+            void possible_pawn_moves(Color color, const Restrictions& r, MoveKind kind, MoveList& actions) const;
+            void possible_piece_moves(Color color, Type type, const Restrictions& r, MoveKind kind, MoveList& actions) const;
+            void possible_king_moves(Color color, const Restrictions& r, MoveKind kind, MoveList& actions) const;
 
             // Convert to SimpleSmallState
             SimpleSmallState to_simple() const;
@@ -189,6 +176,9 @@ namespace Skaia
     };
 }
 
-std::ostream& operator<<(std::ostream& out, const Skaia::State& state);
+// A State holds no pointers or heap memory, so copies for other threads
+//  or for copy-make search are a single memcpy
+static_assert(std::is_trivially_copyable<Skaia::State>::value, "Skaia::State should be trivially copyable");
 
+std::ostream& operator<<(std::ostream& out, const Skaia::State& state);
 
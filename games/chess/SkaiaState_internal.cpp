@@ -2,247 +2,284 @@
 
 #include <algorithm>
 #include <iterator>
-#include <set>
 
 // This file has the implementations for all the generally
 //  uninteresting functions of the State class.
 
 namespace Skaia
 {
-    const State::Square& State::at(int rank, int file) const
+    Type State::at(int rank, int file) const
     {
         return squares[rank * 8 + file];
     }
-    const State::Square& State::at(const Position& pos) const
+    Type State::at(const Position& pos) const
     {
-        return squares[pos.rank * 8 + pos.file];
+        return squares[pos.square()];
     }
-    State::Square& State::at(int rank, int file)
+    Color State::color_at(int square) const
     {
-        return squares[rank * 8 + file];
-    }
-    State::Square& State::at(const Position& pos)
-    {
-        return squares[pos.rank * 8 + pos.file];
-    }
-
-    bool State::empty(const Position& pos) const
-    {
-        return inside(pos) && at(pos).piece == nullptr;
+        return pieces(Black).at(square) ? Black : White;
     }
-    bool State::canTake(const Piece* piece, const Position& pos) const
+    Piece State::piece_at(const Position& pos) const
     {
-        return inside(pos) && (at(pos).piece == nullptr || at(pos).piece->color != piece->color);
-    }
-    bool State::canKill(const Piece* piece, const Position& pos) const
-    {
-        return inside(pos) && at(pos).piece != nullptr && at(pos).piece->color != piece->color;
+        return Piece(pos, at(pos), color_at(pos.square()));
     }
 
-    void State::check_piece(const Piece* piece, bool check)
+    int State::castling_state(Color color) const
     {
-        switch (piece->type)
-        {
-            case Pawn: check_pawn(piece, check); break;
-            case Bishop: check_bishop(piece, check); break;
-            case Knight: check_knight(piece, check); break;
-            case Rook: check_rook(piece, check); break;
-            case Queen: check_bishop(piece, check); check_rook(piece, check); break;
-            case King: check_king(piece, check); break;
-        }
+        int king = color == White ? 60 : 4;
+        if (!special.at(king)) return 0;
+        return (special.at(king + 3) ? 1 : 0) | (special.at(king - 4) ? 2 : 0);
     }
 
-    void State::check_ray(const Piece* piece, const Position& delta, bool check)
+    BitBoard State::attackers_to(int square, BitBoard occupied) const
     {
-        LOG("check_ray");
-        ray_action(piece->pos, delta, [&, this](const Position& pos) {
-            this->at(pos).checks[piece->id] = check;
-        });
+        auto both = [this](Type type) { return pieces(White, type) | pieces(Black, type); };
+        BitBoard queens = both(Queen);
+        return
+            (Attacks::pawn(Black, square) & pieces(White, Pawn)) |
+            (Attacks::pawn(White, square) & pieces(Black, Pawn)) |
+            (Attacks::knight(square) & both(Knight)) |
+            (Attacks::king(square) & both(King)) |
+            (Attacks::bishop(square, occupied) & (both(Bishop) | queens)) |
+            (Attacks::rook(square, occupied) & (both(Rook) | queens));
     }
 
-    void State::check_pos(const Piece* piece, const Position& pos, bool check)
+    bool State::is_attacked(int square, Color by) const
     {
-        if (inside(pos)) at(pos).checks[piece->id] = check;
+        return is_attacked(square, by, occupied());
     }
 
-    void State::check_pawn(const Piece* piece, bool check)
+    bool State::is_attacked(int square, Color by, BitBoard occupied) const
     {
-        LOG("check_pawn");
-        int direction = piece->color ? 1 : -1;
-        check_pos(piece, piece->pos + Position(direction, 1), check);
-        check_pos(piece, piece->pos + Position(direction, -1), check);
+        auto& p = pieces_by_color_and_type[by];
+        return
+            (Attacks::pawn(!by, square) & p[Pawn]).any() ||
+            (Attacks::knight(square) & p[Knight]).any() ||
+            (Attacks::king(square) & p[King]).any() ||
+            (Attacks::bishop(square, occupied) & (p[Bishop] | p[Queen])).any() ||
+            (Attacks::rook(square, occupied) & (p[Rook] | p[Queen])).any();
     }
 
-    void State::check_bishop(const Piece* piece, bool check)
+    void State::place_piece(const Piece& piece)
     {
-        LOG("check_bishop");
-        check_ray(piece, Position(1, 1), check);
-        check_ray(piece, Position(-1, 1), check);
-        check_ray(piece, Position(1, -1), check);
-        check_ray(piece, Position(-1, -1), check);
+        int square = piece.pos.square();
+        squares[square] = piece.type;
+        pieces_by_color_and_type[piece.color][piece.type].set(square);
+        pieces_by_color_and_type[piece.color][Empty].set(square);
+        zobrist.update_piece(square, piece.color, piece.type);
     }
 
-    void State::check_rook(const Piece* piece, bool check)
+    void State::remove_piece(const Position& pos)
     {
-        LOG("check_rook");
-        check_ray(piece, Position(1, 0), check);
-        check_ray(piece, Position(0, 1), check);
-        check_ray(piece, Position(-1, 0), check);
-        check_ray(piece, Position(0, -1), check);
+        int square = pos.square();
+        Color color = color_at(square);
+        zobrist.update_piece(square, color, squares[square]);
+        pieces_by_color_and_type[color][squares[square]].reset(square);
+        pieces_by_color_and_type[color][Empty].reset(square);
+        squares[square] = Empty;
     }
 
-    void State::check_knight(const Piece* piece, bool check)
+    void State::kill_piece(const Position& pos)
     {
-        LOG("check_knight");
-        check_pos(piece, piece->pos + Position(2, 1), check);
-        check_pos(piece, piece->pos + Position(1, 2), check);
-        check_pos(piece, piece->pos + Position(-1, 2), check);
-        check_pos(piece, piece->pos + Position(-2, 1), check);
-        check_pos(piece, piece->pos + Position(-2, -1), check);
-        check_pos(piece, piece->pos + Position(-1, -2), check);
-        check_pos(piece, piece->pos + Position(1, -2), check);
-        check_pos(piece, piece->pos + Position(2, -1), check);
+        remove_piece(pos);
+        since_pawn_or_capture = 0;
+        captured = true;
     }
 
-    void State::check_king(const Piece* piece, bool check)
+    void State::move_piece(const Position& from, const Position& to)
     {
-        LOG("check_king");
-        check_pos(piece, piece->pos + Position(0, 1), check);
-        check_pos(piece, piece->pos + Position(1, 1), check);
-        check_pos(piece, piece->pos + Position(1, 0), check);
-        check_pos(piece, piece->pos + Position(1, -1), check);
-        check_pos(piece, piece->pos + Position(0, -1), check);
-        check_pos(piece, piece->pos + Position(-1, -1), check);
-        check_pos(piece, piece->pos + Position(-1, 0), check);
-        check_pos(piece, piece->pos + Position(-1, 1), check);
+        Piece piece = piece_at(from);
+        remove_piece(from);
+        piece.pos = to;
+        place_piece(piece);
     }
 
-    void State::try_take(const Piece* piece, const Position& to, std::vector<Action>& actions) const
+    void State::add_moves(int from, BitBoard targets, MoveList& actions) const
     {
-        if (canTake(piece, to)) actions.emplace_back(piece->pos, to, Empty);
-    }
-
-    void State::possible_piece_moves(const Piece* piece, std::vector<Action>& actions) const
-    {
-        switch (piece->type)
+        for (int to : targets)
         {
-            case Pawn: possible_pawn_moves(piece, actions); break;
-            case Bishop: possible_bishop_moves(piece, actions); break;
-            case Knight: possible_knight_moves(piece, actions); break;
-            case Rook: possible_rook_moves(piece, actions); break;
-            case Queen: possible_bishop_moves(piece, actions); possible_rook_moves(piece, actions); break;
-            case King: possible_king_moves(piece, actions); break;
+            actions.emplace_back(from, to, Empty);
         }
     }
 
-    void State::pawn_move_with_promotions(const Piece* piece, const Position& to, std::vector<Action>& actions) const
+    void State::pawn_move_with_promotions(int from, int to, MoveList& actions) const
     {
-        if (to.rank == (piece->color ? 7 : 0))
+        if (to < 8 || to >= 56)
         {
-            actions.emplace_back(piece->pos, to, Queen);
+            actions.emplace_back(from, to, Queen);
             // We aint no foo'
-            actions.emplace_back(piece->pos, to, Bishop);
-            actions.emplace_back(piece->pos, to, Knight);
-            actions.emplace_back(piece->pos, to, Rook);
+            actions.emplace_back(from, to, Bishop);
+            actions.emplace_back(from, to, Knight);
+            actions.emplace_back(from, to, Rook);
         }
         else
         {
-            actions.emplace_back(piece->pos, to, Empty);
+            actions.emplace_back(from, to, Empty);
         }
     }
 
-    void State::possible_pawn_moves(const Piece* piece, std::vector<Action>& actions) const
+    State::Restrictions State::restrictions(Color color) const
     {
-        int direction = piece->color ? 1 : -1;
-        // Move forward
-        Position new_pos(piece->pos + Position(direction, 0));
-        if (empty(new_pos)) pawn_move_with_promotions(piece, new_pos, actions);
-        // Move forward twice on first move
-        if (piece->special) // special==true when piece has never moved
+        Restrictions r = unrestricted();
+        BitBoard king = pieces(color, King);
+        if (king.none()) return r;
+        r.king = king.lsb();
+
+        auto& enemy = pieces_by_color_and_type[!color];
+        BitBoard occupied = this->occupied();
+        r.checkers = attackers_to(r.king, occupied) & enemy[Empty];
+        if (r.checkers.several())
         {
-            new_pos = piece->pos + Position(direction * 2, 0);
-            if (empty(piece->pos + Position(direction, 0)) && empty(new_pos)) actions.emplace_back(piece->pos, new_pos, Pawn);
+            // Only the king can get out of a double check
+            r.check_mask = BitBoard();
         }
-        // Attack + En Passant
-        new_pos = piece->pos + Position(direction, -1);
-        if (canKill(piece, new_pos)) pawn_move_with_promotions(piece, new_pos, actions);
-        if (canKill(piece, Position(piece->pos.rank, new_pos.file)) && at(piece->pos.rank, new_pos.file).piece == double_moved_pawn && empty(new_pos)) actions.emplace_back(piece->pos, new_pos, King);
-        new_pos = piece->pos + Position(direction, +1);
-        if (canKill(piece, new_pos)) pawn_move_with_promotions(piece, new_pos, actions);
-        if (canKill(piece, Position(piece->pos.rank, new_pos.file)) && at(piece->pos.rank, new_pos.file).piece == double_moved_pawn && empty(new_pos)) actions.emplace_back(piece->pos, new_pos, King);
+        else if (r.checkers.any())
+        {
+            r.check_mask = Attacks::between(r.king, r.checkers.lsb()) | r.checkers;
+        }
+
+        // Enemy sliders which would attack the king if not for our own pieces
+        BitBoard snipers =
+            (Attacks::rook(r.king, enemy[Empty]) & (enemy[Rook] | enemy[Queen])) |
+            (Attacks::bishop(r.king, enemy[Empty]) & (enemy[Bishop] | enemy[Queen]));
+        for (int sniper : snipers)
+        {
+            BitBoard blockers = Attacks::between(r.king, sniper) & occupied;
+            if (blockers.any() && !blockers.several())
+            {
+                r.pinned |= blockers & pieces(color);
+            }
+        }
+        return r;
     }
 
-    void State::line_moves(const Piece* piece, const Position& delta, std::vector<Action>& actions) const
+    State::Restrictions State::unrestricted()
     {
-        ray_action_const(piece, delta, [&](const Position& new_pos) {
-            actions.emplace_back(piece->pos, new_pos, Empty);
-        });
+        return Restrictions{-1, BitBoard(), ~BitBoard(), BitBoard()};
     }
 
-    void State::possible_bishop_moves(const Piece* piece, std::vector<Action>& actions) const
+    BitBoard State::targets(Color color, MoveKind kind) const
     {
-        line_moves(piece, Position(1, 1), actions);
-        line_moves(piece, Position(-1, 1), actions);
-        line_moves(piece, Position(1, -1), actions);
-        line_moves(piece, Position(-1, -1), actions);
+        switch (kind)
+        {
+            case Captures: return pieces(!color);
+            case Quiets: return ~occupied();
+            default: return ~pieces(color);
+        }
     }
 
-    void State::possible_rook_moves(const Piece* piece, std::vector<Action>& actions) const
+    void State::possible_pawn_moves(Color color, const Restrictions& r, MoveKind kind, MoveList& actions) const
     {
-        line_moves(piece, Position(1, 0), actions);
-        line_moves(piece, Position(0, 1), actions);
-        line_moves(piece, Position(-1, 0), actions);
-        line_moves(piece, Position(0, -1), actions);
+        int direction = color ? 1 : -1;
+        BitBoard pawns = pieces(color, Pawn);
+        BitBoard empty = ~occupied();
+        BitBoard promotions = BitBoard::rank_mask(color ? 7 : 0);
+        // Promotions are sorted in with the captures
+        BitBoard allowed_pushes = kind == Captures ? promotions : kind == Quiets ? ~promotions : ~BitBoard();
+        // Pinned pawns can only move towards or away from their king
+        auto allowed = [&](int from, int to) {
+            return !r.pinned.at(from) || Attacks::line(r.king, from).at(to);
+        };
+        // Move forward
+        BitBoard single = pawns.shifted(direction, 0) & empty;
+        for (int to : single & r.check_mask & allowed_pushes)
+        {
+            int from = to - direction * 8;
+            if (allowed(from, to)) pawn_move_with_promotions(from, to, actions);
+        }
+        if (kind == Quiets || kind == AllMoves)
+        {
+            // Move forward twice on first move
+            BitBoard twice = (single & BitBoard::rank_mask(color ? 2 : 5)).shifted(direction, 0) & empty;
+            for (int to : twice & r.check_mask)
+            {
+                int from = to - direction * 16;
+                if (allowed(from, to)) actions.emplace_back(from, to, Pawn);
+            }
+        }
+        if (kind == Quiets) return;
+        // Attack
+        for (int file_delta : {-1, 1})
+        {
+            BitBoard attacks = pawns.shifted(direction, file_delta) & pieces(!color) & r.check_mask;
+            for (int to : attacks)
+            {
+                int from = to - direction * 8 - file_delta;
+                if (allowed(from, to)) pawn_move_with_promotions(from, to, actions);
+            }
+        }
+        // En Passant
+        if (double_moved_pawn != -1 && color_at(double_moved_pawn) != color)
+        {
+            int to = double_moved_pawn + direction * 8;
+            for (int from : Attacks::pawn(!color, to) & pawns)
+            {
+                // Two pawns leave the same rank at once, so rather than using the pins
+                //  check directly whether the king would be attacked afterwards
+                if (r.king != -1)
+                {
+                    BitBoard after = occupied() ^ BitBoard::square(from) ^ BitBoard::square(to) ^
+                        BitBoard::square(double_moved_pawn);
+                    BitBoard attackers = attackers_to(r.king, after) & pieces(!color) &
+                        ~BitBoard::square(double_moved_pawn);
+                    if (attackers.any()) continue;
+                }
+                actions.emplace_back(from, to, King);
+            }
+        }
     }
 
-    void State::possible_knight_moves(const Piece* piece, std::vector<Action>& actions) const
+    void State::possible_piece_moves(Color color, Type type, const Restrictions& r, MoveKind kind, MoveList& actions) const
     {
-        try_take(piece, piece->pos + Position(-2, +1), actions);
-        try_take(piece, piece->pos + Position(-1, +2), actions);
-        try_take(piece, piece->pos + Position(+1, +2), actions);
-        try_take(piece, piece->pos + Position(+2, +1), actions);
-        try_take(piece, piece->pos + Position(+2, -1), actions);
-        try_take(piece, piece->pos + Position(+1, -2), actions);
-        try_take(piece, piece->pos + Position(-1, -2), actions);
-        try_take(piece, piece->pos + Position(-2, -1), actions);
+        BitBoard occupied = this->occupied();
+        BitBoard targets = this->targets(color, kind) & r.check_mask;
+        for (int from : pieces(color, type))
+        {
+            BitBoard moves = Attacks::piece(type, color, from, occupied) & targets;
+            if (r.pinned.at(from)) moves &= Attacks::line(r.king, from);
+            add_moves(from, moves, actions);
+        }
     }
 
-    void State::possible_king_moves(const Piece* piece, std::vector<Action>& actions) const
+    void State::possible_king_moves(Color color, const Restrictions& r, MoveKind kind, MoveList& actions) const
     {
-        try_take(piece, piece->pos + Position(0, 1), actions);
-        try_take(piece, piece->pos + Position(1, 1), actions);
-        try_take(piece, piece->pos + Position(1, 0), actions);
-        try_take(piece, piece->pos + Position(1, -1), actions);
-        try_take(piece, piece->pos + Position(0, -1), actions);
-        try_take(piece, piece->pos + Position(-1, -1), actions);
-        try_take(piece, piece->pos + Position(-1, 0), actions);
-        try_take(piece, piece->pos + Position(-1, 1), actions);
+        BitBoard occupied = this->occupied();
+        for (int from : pieces(color, King))
+        {
+            BitBoard moves = Attacks::king(from) & targets(color, kind);
+            if (r.king != -1)
+            {
+                // The king can't hide behind itself from a slider
+                BitBoard without_king = occupied ^ BitBoard::square(from);
+                for (int to : moves)
+                {
+                    if (is_attacked(to, !color, without_king)) moves.reset(to);
+                }
+            }
+            add_moves(from, moves, actions);
+        }
+        if (kind == Captures) return;
         // Castle
-        if (piece->special && at(piece->pos).checked_by_color(!piece->color ? Black : White))
+        for (int from : pieces(color, King) & special)
         {
-            auto empty_and_unchecked = [this, &piece, &actions](const Position& pos) {
-                return empty(pos) && !at(pos).checked_by_color(!piece->color ? Black : White);
+            if (r.checkers.any() || is_attacked(from, !color)) continue;
+            auto empty_and_unchecked = [&](int file_delta) {
+                int square = from + file_delta;
+                return !occupied.at(square) && !is_attacked(square, !color);
             };
             // Queen-side castle
-            if (empty_and_unchecked(piece->pos + Position(0, -1)) &&
-                    empty_and_unchecked(piece->pos + Position(0, -2)) &&
-                    empty_and_unchecked(piece->pos + Position(0, -3)) &&
-                    at(piece->pos + Position(0, -4)).piece->type == Rook &&
-                    at(piece->pos + Position(0, -4)).piece->special &&
-                    at(piece->pos + Position(0, -4)).checked_by_color(!piece->color ? Black : White))
+            if (special.at(from - 4) && (pieces(color, Rook).at(from - 4)) &&
+                    !occupied.at(from - 3) && empty_and_unchecked(-1) && empty_and_unchecked(-2))
             {
-                actions.emplace_back(piece->pos, piece->pos + Position(0, -2), King);
+                actions.emplace_back(from, from - 2, King);
             }
             // King-side castle
-            else if (empty_and_unchecked(piece->pos + Position(0, 1)) &&
-                    empty_and_unchecked(piece->pos + Position(0, 2)) &&
-                    at(piece->pos + Position(0, 3)).piece->type == Rook &&
-                    at(piece->pos + Position(0, 3)).piece->special &&
-                    at(piece->pos + Position(0, 3)).checked_by_color(!piece->color ? Black : White))
+            if (special.at(from + 3) && (pieces(color, Rook).at(from + 3)) &&
+                    empty_and_unchecked(1) && empty_and_unchecked(2))
             {
-                actions.emplace_back(piece->pos, piece->pos + Position(0, 2), King);
+                actions.emplace_back(from, from + 2, King);
             }
         }
     }
 }
-
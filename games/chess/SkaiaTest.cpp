@@ -3,24 +3,54 @@
 #include "SkaiaTest.h"
 
 #include "SkaiaBackAction.h"
+#include "SkaiaMM.h"
+#include "TranspositionTable.h"
 
-void print_checks(const Skaia::State& state, int piece_id)
+#include <algorithm>
+#include <limits>
+#include <set>
+
+// Prints the squares attacked by the piece at pos
+void print_checks(const Skaia::State& state, const Skaia::Position& pos)
 {
-    for (int rank = 0; rank < 8; ++rank)
-    {
-        for (int file = 0; file < 8; ++file)
-        {
-            auto& square = state.at(rank, file);
-            char symbol = '.';
-            if (square.checks[piece_id]) symbol = 'c';
-            std::cout << symbol << " ";
-        }
-        std::cout << std::endl;
-    }
+    auto piece = state.piece_at(pos);
+    std::cout << Skaia::Attacks::piece(piece.type, piece.color, pos.square(), state.occupied());
 }
 
 using namespace Skaia;
 
+// Walks every line of play to the given depth, checking that the legal move
+//  generator agrees with the (slow) filtering one at every state
+bool check_generators(State& state, int depth)
+{
+    auto actions = state.generate_actions();
+    auto filtered = state.generate_filtered_actions();
+    if (std::set<Action>(actions.begin(), actions.end()) != std::set<Action>(filtered.begin(), filtered.end()))
+    {
+        std::cerr << "Generators disagree on state:" << std::endl << state;
+        return false;
+    }
+    // Captures and quiet moves should split the moves between them
+    MoveList staged;
+    auto r = state.restrictions(state.to_move());
+    state.generate_actions(State::Captures, r, staged);
+    state.generate_actions(State::Quiets, r, staged);
+    if (staged.size() != actions.size() || std::set<Action>(staged.begin(), staged.end()) != std::set<Action>(actions.begin(), actions.end()))
+    {
+        std::cerr << "Captures and quiets don't add up to all moves on state:" << std::endl << state;
+        return false;
+    }
+    if (depth == 0) return true;
+    for (auto& action : actions)
+    {
+        auto back_action = state.apply_action(action);
+        bool same = check_generators(state, depth - 1);
+        state.apply_back_action(back_action);
+        if (!same) return false;
+    }
+    return true;
+}
+
 void SkaiaTest()
 {
     std::cout << sign(-2) << " " << sign(5) << " " << sign(0) << std::endl;
@@ -30,26 +60,27 @@ void SkaiaTest()
 
     std::cout << "material: " << state.material(White) << " " << state.material(Black) << std::endl;
 
-    Skaia::Piece* q = nullptr;
-    Skaia::Piece* Q = nullptr;
-    // Remove all pieces
-    for (auto& piece : state.pieces)
+    // Remove all pieces except for the queens
+    Position q(7, 3), Q(0, 3);
+    for (int square : state.occupied())
     {
-        if (piece.type == Skaia::Queen && piece.color == Skaia::White) {q = &piece; continue;}
-        if (piece.type == Skaia::Queen && piece.color == Skaia::Black) {Q = &piece; continue;}
-        state.kill_piece(&piece);
+        if (state.squares[square] == Skaia::Queen) continue;
+        state.kill_piece(Position::from_square(square));
     }
 
-    if (q == nullptr) std::cerr << "White queen not found!" << std::endl;
-    print_checks(state, q->id);
-    state.move_piece(q->pos, Skaia::Position(0, 0));
-    print_checks(state, q->id);
-    state.move_piece(Q->pos, Skaia::Position(3, 3));
-    print_checks(state, q->id);
-    print_checks(state, Q->id);
-    state.apply_action(Skaia::Action(Q->pos, Q->pos + Position(-1, -1), Skaia::Empty));
-    print_checks(state, q->id);
-    print_checks(state, Q->id);
+    if (state.at(q) != Skaia::Queen) std::cerr << "White queen not found!" << std::endl;
+    print_checks(state, q);
+    state.move_piece(q, Skaia::Position(0, 0));
+    q = Skaia::Position(0, 0);
+    print_checks(state, q);
+    state.move_piece(Q, Skaia::Position(3, 3));
+    Q = Skaia::Position(3, 3);
+    print_checks(state, q);
+    print_checks(state, Q);
+    state.apply_action(Skaia::Action(Q, Q + Position(-1, -1), Skaia::Empty));
+    Q = Q + Position(-1, -1);
+    print_checks(state, q);
+    print_checks(state, Q);
 
     std::cout << "material: " << state.material(White) << " " << state.material(Black) << std::endl;
 
@@ -58,12 +89,131 @@ void SkaiaTest()
 
     std::cout << "Testing normal move back action ";
     State a, b;
-    Piece empty_piece;
-    uint64_t null_history = 0;
-    BackAction back_action{Empty, a.pieces[16], empty_piece, null_history, -1, a.since_pawn_or_capture};
-    b.apply_action(Action(a.pieces[16].pos, a.pieces[16].pos + Position(-2, 0), Empty));
+    Position pawn(6, 0);
+    BackAction back_action = b.apply_action(Action(pawn, pawn + Position(-2, 0), Pawn));
     b.apply_back_action(back_action);
     std::cout << (a == b) << std::endl;
     std::cout << "Testing cout of state: " << a << std::endl;
-}
 
+    std::cout << "Testing draw by repeat ";
+    // Shuffle the knights back and forth, then undo it all
+    std::vector<BackAction> back_actions;
+    Position knights[2][2] = {{Position(7, 1), Position(5, 2)}, {Position(0, 1), Position(2, 2)}};
+    // Each position comes back every four actions: once is only a draw inside a search,
+    //  and it takes twice for the rules. Black can go back to the start after three.
+    bool repeats = true;
+    for (int move = 0; move < 12; ++move)
+    {
+        auto& knight = knights[move % 2];
+        back_actions.push_back(b.apply_action(Action(knight[(move / 2) % 2], knight[(move / 2 + 1) % 2], Empty)));
+        if (move == 2) repeats = repeats && b.upcoming_repetition(4) && !b.upcoming_repetition(3);
+        if (move == 3) repeats = repeats && !b.draw() && b.draw(5) && !b.draw(4);
+    }
+    std::cout << repeats << " " << b.draw() << " ";
+    while (!back_actions.empty())
+    {
+        b.apply_back_action(back_actions.back());
+        back_actions.pop_back();
+    }
+    std::cout << (a == b) << std::endl;
+
+    std::cout << "Testing long undo ";
+    // Shuffle one pair of knights, copy, then shuffle the other pair for as long as a search
+    //  may go. That writes over keys the copy still needs, undoing it should put them back.
+    State shuffled, copied;
+    Position other_knights[2][2] = {{Position(7, 6), Position(5, 5)}, {Position(0, 6), Position(2, 5)}};
+    for (int move = 0; move < 96 + State::max_ply - 1; ++move)
+    {
+        if (move == 96) copied = shuffled;
+        auto& knight = move < 96 ? knights[move % 2] : other_knights[move % 2];
+        back_actions.push_back(shuffled.apply_action(Action(knight[(move / 2) % 2], knight[(move / 2 + 1) % 2], Empty)));
+    }
+    while (back_actions.size() > 96)
+    {
+        shuffled.apply_back_action(back_actions.back());
+        back_actions.pop_back();
+    }
+    back_actions.clear();
+    std::cout << (shuffled == copied) << std::endl;
+
+    std::cout << "Testing legal move generation ";
+    std::cout << check_generators(a, 3) << std::endl;
+
+    std::cout << "Testing FEN ";
+    std::string start_fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    std::cout << (State::from_fen(start_fen) == State() && State().to_fen() == start_fen) << " ";
+    // A fresh state and one reached by moving should agree, hash and all
+    State moved;
+    for (auto& action : {Action(Position(6, 4), Position(4, 4), Pawn), Action(Position(0, 6), Position(2, 5), Empty),
+            Action(Position(4, 4), Position(3, 4), Empty), Action(Position(1, 3), Position(3, 3), Pawn)})
+    {
+        moved.apply_action(action);
+    }
+    State loaded = State::from_fen(moved.to_fen());
+    std::cout << (loaded.to_fen() == moved.to_fen() && loaded.zobrist.hash == moved.zobrist.hash) <<
+        " " << moved.to_fen() << std::endl;
+
+    std::cout << "Testing null action ";
+    // Passing loses the chance to take en passant, and undoing it gets everything back
+    State passed = moved;
+    back_action = passed.apply_null_action();
+    std::cout << (State::from_fen(passed.to_fen()).zobrist.hash == passed.zobrist.hash && passed.double_moved_pawn == -1) << " ";
+    passed.apply_null_back_action(back_action);
+    std::cout << (passed == moved) << std::endl;
+
+    std::cout << "Testing static exchange ";
+    // Knight takes a defended pawn and loses out after everything is traded off,
+    //  a rook takes an undefended pawn, and a pawn takes a knight while promoting
+    State exchange = State::from_fen("1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1");
+    // see_ge should agree with see just below, at, and just above the exact value
+    auto thresholds = [&exchange](const Action& action, int value)
+    {
+        return exchange.see(action) == value && exchange.see_ge(action, value - 1) &&
+            exchange.see_ge(action, value) && !exchange.see_ge(action, value + 1);
+    };
+    std::cout << thresholds(Action(Position(5, 3), Position(3, 4), Empty), -2) << " ";
+    exchange = State::from_fen("1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1");
+    std::cout << thresholds(Action(Position(7, 4), Position(3, 4), Empty), 1) << " ";
+    exchange = State::from_fen("rn2k3/P7/8/8/8/8/8/4K3 w - - 0 1");
+    std::cout << thresholds(Action(Position(1, 0), Position(0, 1), Queen), 2) << std::endl;
+
+    std::cout << "Testing transposition table replacement ";
+    // A shallower result doesn't evict a deeper one from the same search,
+    //  but an exact one does, and so does anything from a later search
+    TranspositionTable table(1);
+    TranspositionTable::Entry entry;
+    uint64_t hash = a.zobrist.hash;
+    table.store(hash, 10, Action(), 6, TranspositionTable::Lower);
+    table.store(hash, 20, Action(), 2, TranspositionTable::Upper);
+    bool kept = table.probe(hash, entry) && entry.depth == 6 && entry.score == 10;
+    table.store(hash, 30, Action(), 2, TranspositionTable::Exact);
+    bool exact = table.probe(hash, entry) && entry.depth == 2 && entry.score == 30;
+    table.store(hash, 40, Action(), 5, TranspositionTable::Lower);
+    table.new_search();
+    table.store(hash, 50, Action(), 1, TranspositionTable::Upper);
+    bool aged = table.probe(hash, entry) && entry.depth == 1 && entry.score == 50;
+    std::cout << kept << " " << exact << " " << aged << std::endl;
+
+    std::cout << "Testing search from a repeated position ";
+    // Both players bring their knights out and back twice, so the start is on the board
+    //  for the third time. The root is already a draw, but it still has to give an action to play.
+    State repeated;
+    for (auto& action : {Action(Position(7, 6), Position(5, 5), Empty), Action(Position(0, 6), Position(2, 5), Empty),
+            Action(Position(5, 5), Position(7, 6), Empty), Action(Position(2, 5), Position(0, 6), Empty),
+            Action(Position(7, 1), Position(5, 2), Empty), Action(Position(0, 1), Position(2, 2), Empty),
+            Action(Position(5, 2), Position(7, 1), Empty), Action(Position(2, 2), Position(0, 1), Empty)})
+    {
+        repeated.apply_action(action);
+    }
+    HistoryTable history;
+    SearchStack search_stack(repeated);
+    auto legal = repeated.generate_actions();
+    bool legal_result = repeated.draw();
+    for (int depth = 1; depth <= 3; ++depth)
+    {
+        auto ret = minimax(repeated, repeated.to_move(), depth, std::numeric_limits<int>::lowest(),
+                std::numeric_limits<int>::max(), history, table, search_stack);
+        legal_result = legal_result && std::find(legal.begin(), legal.end(), ret.action) != legal.end();
+    }
+    std::cout << legal_result << std::endl;
+}
@@ -3,6 +3,5 @@
 #include "SkaiaState.h"
 #include <iostream>
 
-void print_checks(const Skaia::State& state, int piece_id);
+void print_checks(const Skaia::State& state, const Skaia::Position& pos);
 void SkaiaTest();
-
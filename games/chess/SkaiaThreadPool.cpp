@@ -0,0 +1,44 @@
+#include "SkaiaThreadPool.h"
+
+#include <algorithm>
+
+namespace Skaia
+{
+    ThreadPool::ThreadPool(int workers) : workers(), jobs(), mutex(), wake(), closing(false)
+    {
+        for (int i = 0; i < std::max(workers, 1); ++i)
+        {
+            this->workers.emplace_back(&ThreadPool::work, this);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closing = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::work()
+    {
+        while (true)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return closing || !jobs.empty(); });
+                // Jobs left when closing still run, so every future becomes ready
+                if (jobs.empty()) return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+}
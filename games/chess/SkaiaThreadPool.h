@@ -0,0 +1,57 @@
+#pragma once
+
+// A fixed set of worker threads which live as long as the pool does.
+// Jobs are handed to the workers through a condition variable, and each
+//  job's result comes back through a std::future, so no one has to spin
+//  waiting for a thread to finish.
+// A search job should check a stop flag of its own and return its best result once it is set.
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Skaia
+{
+    class ThreadPool
+    {
+        public:
+            // Starts the workers, at least one
+            explicit ThreadPool(int workers);
+            ThreadPool(const ThreadPool& other) = delete;
+            ThreadPool& operator=(const ThreadPool& other) = delete;
+            // Waits for every job that was submitted to finish
+            ~ThreadPool();
+
+            int size() const { return static_cast<int>(workers.size()); }
+
+            // Runs job() on the next free worker. The future is ready once it returns.
+            template <typename F>
+            std::future<typename std::result_of<F()>::type> submit(F job)
+            {
+                typedef typename std::result_of<F()>::type Result;
+                auto task = std::make_shared<std::packaged_task<Result()>>(std::move(job));
+                auto result = task->get_future();
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    jobs.emplace_back([task] { (*task)(); });
+                }
+                wake.notify_one();
+                return result;
+            }
+
+        private:
+            std::vector<std::thread> workers;
+            std::deque<std::function<void()>> jobs; // Waiting for a free worker, oldest first
+            std::mutex mutex; // Guards jobs and closing
+            std::condition_variable wake; // Signalled when there is a job, or the pool is closing
+            bool closing;
+
+            void work();
+    };
+}
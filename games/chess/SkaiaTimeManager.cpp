@@ -0,0 +1,87 @@
+#include "SkaiaTimeManager.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Skaia
+{
+    namespace
+    {
+        // Kept back from the remaining time for talking to the server
+        const TimeManager::Duration overhead = std::chrono::milliseconds(300);
+        // Games are planned as lasting this many more moves, but never fewer than the minimum
+        const int expected_moves = 50;
+        const int min_moves_to_go = 20;
+        // How many of the latest depths the branching factor is fitted over
+        const size_t fitted_depths = 4;
+    }
+
+    TimeManager::TimeManager(Clock::time_point start, Duration remaining, Duration increment,
+            int move_number, int legal_actions) :
+        start(start), soft_limit(0), hard_limit(0), best(), stable_depths(0),
+        iterations(), last_finish(start), finished(false)
+    {
+        if (legal_actions <= 1) return;
+        Duration usable = std::max(remaining - overhead, Duration(0));
+        int moves_to_go = std::max(expected_moves - move_number, min_moves_to_go);
+        soft_limit = usable / moves_to_go + increment * 3 / 4;
+        // A search may run well past the soft limit, but never use up too much of the clock
+        hard_limit = std::min(soft_limit * 4, usable / 4 + increment);
+        soft_limit = std::min(soft_limit, hard_limit);
+    }
+
+    bool TimeManager::depth_finished(const Action& best, int states_evaluated)
+    {
+        auto now = Clock::now();
+        iterations.push_back(Iteration{states_evaluated, now - last_finish});
+        last_finish = now;
+        stable_depths = best == this->best ? stable_depths + 1 : 0;
+        this->best = best;
+        // Spend less of the soft limit the longer the best action hasn't changed
+        static const int percent_of_soft[] = {120, 90, 70, 50};
+        int percent = percent_of_soft[std::min(stable_depths, 3)];
+        if (elapsed() >= soft_limit * percent / 100) return true;
+        // Don't start a depth that would be cut off by the hard limit
+        return elapsed() + predict_next() > hard_limit;
+    }
+
+    double TimeManager::branching_factor() const
+    {
+        if (iterations.size() < 2) return 0;
+        size_t first = iterations.size() - std::min(iterations.size(), fitted_depths);
+        double ratio = static_cast<double>(std::max(iterations.back().states_evaluated, 1)) /
+            std::max(iterations[first].states_evaluated, 1);
+        // The geometric mean of the growth from each depth to the next
+        return std::max(1.0, std::pow(ratio, 1.0 / (iterations.size() - 1 - first)));
+    }
+
+    TimeManager::Duration TimeManager::predict_next() const
+    {
+        if (iterations.size() < 2) return Duration(0);
+        // States per nanosecond over every depth so far
+        double states = 0, time = 0;
+        for (auto& iteration : iterations)
+        {
+            states += iteration.states_evaluated;
+            time += iteration.time.count();
+        }
+        if (states <= 0 || time <= 0) return Duration(0);
+        double next_states = iterations.back().states_evaluated * branching_factor();
+        return Duration(static_cast<Duration::rep>(next_states * time / states));
+    }
+
+    void TimeManager::finish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished = true;
+        }
+        wake.notify_all();
+    }
+
+    void TimeManager::wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait_until(lock, start + hard_limit, [this] { return finished; });
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// Decides how long a turn's search may run.
+// The soft limit is how long the search should usually take, checked
+//  whenever a depth finishes, and it shrinks the longer the best action
+//  stays the same. The hard limit is when the search is stopped no
+//  matter what.
+// Each finished depth's node count and time are recorded, and the effective
+//  branching factor fitted from them predicts how long the next depth will
+//  take, so a depth that can't finish before the hard limit isn't started.
+// The thread waiting on the search sleeps on a condition variable, and
+//  is woken as soon as the search decides it is done.
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "SkaiaAction.h"
+
+namespace Skaia
+{
+    class TimeManager
+    {
+        public:
+            typedef std::chrono::steady_clock Clock;
+            typedef std::chrono::nanoseconds Duration;
+
+            // Budgets a turn that started at start, with remaining time left on our clock,
+            //  increment added after each move, and move_number moves made already.
+            // With only one legal action there is nothing to think about, and both limits are zero.
+            TimeManager(Clock::time_point start, Duration remaining, Duration increment,
+                    int move_number, int legal_actions);
+
+            const Clock::time_point start;
+            Duration soft_limit;
+            Duration hard_limit;
+
+            Duration elapsed() const { return Clock::now() - start; }
+
+            // Called by the main search each time it finishes a depth, with the states it
+            //  evaluated doing so, returns true if there is no point starting another
+            bool depth_finished(const Action& best, int states_evaluated);
+
+            // How many times more states each depth takes than the one before,
+            //  fitted over the last few depths, or 0 before there are two
+            double branching_factor() const;
+            // How long the next depth should take, or zero if it can't be guessed yet
+            Duration predict_next() const;
+
+            // Wakes wait(), the search is done
+            void finish();
+            // Sleeps until finish() is called or the hard limit passes
+            void wait();
+
+        private:
+            Action best;
+            int stable_depths; // How many depths in a row have agreed on best
+
+            struct Iteration
+            {
+                int states_evaluated;
+                Duration time;
+            };
+            std::vector<Iteration> iterations; // Every finished depth, in order
+            Clock::time_point last_finish; // When the last depth finished, or start
+
+            std::mutex mutex;
+            std::condition_variable wake;
+            bool finished;
+    };
+}
@@ -0,0 +1,115 @@
+#include "TranspositionTable.h"
+
+#include <algorithm>
+#include <new>
+
+static_assert(sizeof(TranspositionTable::Bucket::Slot) == 16, "Entries should stay small enough to fit four to a bucket");
+static_assert(sizeof(TranspositionTable::Bucket) == 64, "A bucket should fill one cache line");
+
+TranspositionTable::TranspositionTable(size_t megabytes) : age(0), storage(), buckets(nullptr), size(1)
+{
+    while (size * 2 * sizeof(Bucket) <= megabytes * 1024 * 1024)
+    {
+        size *= 2;
+    }
+    storage.resize(size * sizeof(Bucket) + alignof(Bucket));
+    auto address = reinterpret_cast<uintptr_t>(storage.data());
+    buckets = reinterpret_cast<Bucket*>((address + alignof(Bucket) - 1) & ~(alignof(Bucket) - 1));
+    for (size_t i = 0; i < size; ++i)
+    {
+        new (&buckets[i]) Bucket();
+    }
+    clear();
+}
+
+// Data is laid out as the score in the low 32 bits, then the action, the depth,
+//  and the bound in the top two bits under the age
+uint64_t TranspositionTable::pack(const Entry& entry)
+{
+    return static_cast<uint64_t>(static_cast<uint32_t>(entry.score)) |
+        static_cast<uint64_t>(entry.action.data) << 32 |
+        static_cast<uint64_t>(entry.depth) << 48 |
+        static_cast<uint64_t>(entry.age & age_mask) << 56 |
+        static_cast<uint64_t>(entry.bound) << 62;
+}
+
+TranspositionTable::Entry TranspositionTable::unpack(uint64_t data)
+{
+    Entry entry;
+    entry.score = static_cast<int32_t>(static_cast<uint32_t>(data));
+    entry.action.data = static_cast<uint16_t>(data >> 32);
+    entry.depth = static_cast<uint8_t>(data >> 48);
+    entry.age = static_cast<uint8_t>(data >> 56) & age_mask;
+    entry.bound = static_cast<Bound>(data >> 62);
+    return entry;
+}
+
+bool TranspositionTable::probe(uint64_t hash, Entry& entry) const
+{
+    for (auto& slot : bucket(hash).slots)
+    {
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        if ((slot.check.load(std::memory_order_relaxed) ^ data) == hash && data != 0)
+        {
+            entry = unpack(data);
+            return entry.bound != None;
+        }
+    }
+    return false;
+}
+
+void TranspositionTable::store(uint64_t hash, int score, const Skaia::Action& action, int depth, Bound bound)
+{
+    Bucket::Slot* replace = nullptr;
+    Entry replace_entry;
+    for (auto& slot : bucket(hash).slots)
+    {
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        Entry entry = unpack(data);
+        // Overwrite the same state, unless this search already went deeper on it.
+        //  Exact results and entries from earlier searches are always replaced.
+        if ((slot.check.load(std::memory_order_relaxed) ^ data) == hash)
+        {
+            if (bound != Exact && entry.age == age && entry.depth > std::max(depth, 0))
+            {
+                return;
+            }
+            replace = &slot;
+            break;
+        }
+        // Otherwise prefer entries from old searches, then shallow ones
+        if (replace == nullptr ||
+                (entry.age != age && replace_entry.age == age) ||
+                ((entry.age == age) == (replace_entry.age == age) && entry.depth < replace_entry.depth))
+        {
+            replace = &slot;
+            replace_entry = entry;
+        }
+    }
+    Entry entry;
+    entry.score = score;
+    entry.action = action;
+    entry.depth = static_cast<uint8_t>(std::min(std::max(depth, 0), 255));
+    entry.bound = bound;
+    entry.age = age;
+    uint64_t data = pack(entry);
+    replace->check.store(hash ^ data, std::memory_order_relaxed);
+    replace->data.store(data, std::memory_order_relaxed);
+}
+
+void TranspositionTable::new_search()
+{
+    age = (age + 1) & age_mask;
+}
+
+void TranspositionTable::clear()
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        for (auto& slot : buckets[i].slots)
+        {
+            slot.check.store(0, std::memory_order_relaxed);
+            slot.data.store(0, std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,85 @@
+/// Remembers the results of searches by the Zobrist hash of the state they
+///  were run from, so that a state which is reached again (by a
+///  different order of moves, or on the next iteration of deepening) does
+///  not have to be searched from scratch.
+/// Scores are stored for the player to move in the state. The heuristic
+///  they come from depends on who it evaluates for, so every search that
+///  shares a table should evaluate for the same player.
+/// Any number of threads may probe and store at once without locking.
+///  Each entry is two atomic words, and the first is the hash xor'ed with
+///  the second, so an entry torn by two threads storing at once just
+///  fails to match any hash.
+
+#pragma once
+
+#include "SkaiaAction.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+class TranspositionTable
+{
+    public:
+        // What the stored score says about the real score of the state
+        enum Bound : uint8_t {None, Exact, Lower, Upper};
+
+        // An entry as it is handed out, unpacked from the table
+        struct Entry
+        {
+            int32_t score; // For the player to move in the state
+            Skaia::Action action; // The best action found
+            uint8_t depth; // How many ply deep the search went
+            Bound bound;
+            uint8_t age; // The search this was stored during
+
+            Entry() : score(0), action(), depth(0), bound(None), age(0) {}
+        };
+
+        // Entries are grouped so that a bucket fills exactly one cache line
+        static const int bucket_size = 4;
+        struct alignas(64) Bucket
+        {
+            struct Slot
+            {
+                std::atomic<uint64_t> check; // The hash xor data
+                std::atomic<uint64_t> data; // The packed Entry
+            };
+            Slot slots[bucket_size];
+        };
+
+        // Ages count the searches, and wrap around so they fit beside the bound
+        static const uint8_t age_mask = 0x3f;
+        uint8_t age;
+
+        // The number of buckets is rounded down to a power of two that fits in the given size
+        TranspositionTable(size_t megabytes);
+        TranspositionTable(const TranspositionTable& other) = delete;
+        TranspositionTable& operator=(const TranspositionTable& other) = delete;
+
+        // Returns true and sets entry if there is one for the hash
+        bool probe(uint64_t hash, Entry& entry) const;
+
+        // Stores a result, replacing whichever entry in the bucket is the
+        //  least useful (an older search, or a shallower one).
+        //  A deeper entry for the same hash from this search is kept instead,
+        //  unless the new result is Exact.
+        void store(uint64_t hash, int score, const Skaia::Action& action, int depth, Bound bound);
+
+        // Call at the start of every turn so that old entries are replaced first.
+        //  This must not be called while another thread is searching.
+        void new_search();
+
+        void clear();
+
+    private:
+        std::vector<uint8_t> storage; // Holds the buckets, with room to align them to a cache line
+        Bucket* buckets;
+        size_t size; // Number of buckets, always a power of two
+
+        static uint64_t pack(const Entry& entry);
+        static Entry unpack(uint64_t data);
+
+        Bucket& bucket(uint64_t hash) { return buckets[hash & (size - 1)]; }
+        const Bucket& bucket(uint64_t hash) const { return buckets[hash & (size - 1)]; }
+};
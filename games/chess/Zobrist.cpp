@@ -1,44 +1,71 @@
 #include "Zobrist.h"
 
-Zobrist::Zobrist(uint64_t seed) :
-    random(seed)
-{
-    hash = random();
-    for (auto i = 0; i < piece_values.size(); ++i)
-    {
-        piece_values[i] = random();
-    }
-    for (auto i = 0; i < color_values.size(); +i)
-    {
-        color_values[i] = random();
-    }
-    for (auto i = 0; i < castleing_values.size(); +i)
-    {
-        castleing_values[i] = random();
-    }
-    for (auto i = 0; i < enpassant_values.size(); +i)
-    {
-        enpassant_values[i] = random();
-    }
-}
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
 
-void Zobrist::update_piece(const Skaia::Position &pos, const Skaia::Color &color, const Skaia::Type &type)
-{
-    hash ^= piece_values[color * 384 + pos.rank * 42 + pos.file * 6 + (static_cast<int>(type) - 1)];
-}
+std::array<uint64_t, 2 * 6 * 8 * 8> Zobrist::piece_values;
+std::array<uint64_t, 2> Zobrist::color_values;
+std::array<uint64_t, 8> Zobrist::castleing_values;
+std::array<uint64_t, 8> Zobrist::enpassant_values;
+std::array<uint64_t, 8192> Zobrist::cuckoo;
+std::array<uint16_t, 8192> Zobrist::cuckoo_squares;
 
-void Zobrist::toggle_color(const Skaia::Color& color)
+namespace
 {
-    hash ^= color_values[static_cast<int>(color)];
-}
+    struct Initializer
+    {
+        Initializer()
+        {
+            std::mt19937_64 random(13315146811210211749ull);
+            for (auto& value : Zobrist::piece_values) value = random();
+            for (auto& value : Zobrist::color_values) value = random();
+            for (auto& value : Zobrist::castleing_values) value = random();
+            for (auto& value : Zobrist::enpassant_values) value = random();
 
-void Zobrist::update_castling(const Skaia::Color& color, int state)
-{
-    hash ^= castleing_values[color * 4 + state];
-}
+            // Fill the cuckoo tables, each action kicks out whatever is in its slot
+            //  and that goes to its other slot, until one lands in an empty slot
+            for (Skaia::Color color : {Skaia::White, Skaia::Black})
+            {
+                for (Skaia::Type type : {Skaia::Bishop, Skaia::Knight, Skaia::Rook, Skaia::Queen, Skaia::King})
+                {
+                    for (int from = 0; from < 64; ++from)
+                    {
+                        for (int to = from + 1; to < 64; ++to)
+                        {
+                            if (!reaches(type, from, to)) continue;
+                            uint64_t key = Zobrist::piece_value(from, color, type) ^ Zobrist::piece_value(to, color, type) ^
+                                Zobrist::color_values[0] ^ Zobrist::color_values[1];
+                            uint16_t squares = static_cast<uint16_t>(from * 64 + to);
+                            int slot = Zobrist::cuckoo_first(key);
+                            while (true)
+                            {
+                                std::swap(Zobrist::cuckoo[slot], key);
+                                std::swap(Zobrist::cuckoo_squares[slot], squares);
+                                if (key == 0) break;
+                                slot = slot == Zobrist::cuckoo_first(key) ? Zobrist::cuckoo_second(key) : Zobrist::cuckoo_first(key);
+                            }
+                        }
+                    }
+                }
+            }
+        }
 
-void Zobrist::update_enpassant(int file)
-{
-    hash ^= enpassant_values[file];
+        // Whether a piece can move between two squares on an empty board
+        static bool reaches(Skaia::Type type, int from, int to)
+        {
+            int ranks = std::abs(from / 8 - to / 8), files = std::abs(from % 8 - to % 8);
+            bool straight = ranks == 0 || files == 0, diagonal = ranks == files;
+            switch (type)
+            {
+                case Skaia::Bishop: return diagonal;
+                case Skaia::Knight: return ranks * files == 2;
+                case Skaia::Rook: return straight;
+                case Skaia::Queen: return straight || diagonal;
+                case Skaia::King: return std::max(ranks, files) == 1;
+                default: return false;
+            }
+        }
+    };
+    Initializer initializer;
 }
-
@@ -15,21 +15,48 @@ class Zobrist
     public:
         uint64_t hash;
 
+        // Random values shared by every Zobrist, these are filled in once when the program starts
         // An array of values which correspond to a given type and a given position
-        std::array<uint64_t, 2 * 6 * 8 * 8> piece_values;
-        std::array<uint64_t, 2> color_values; // [0] for White, [1] for Black
-        std::array<uint64_t, 8> castleing_values; // 0/1/2/3 for White castle None/King/Queen/Both side
-        std::array<uint64_t, 8> enpassant_values; // One for each file
+        static std::array<uint64_t, 2 * 6 * 8 * 8> piece_values;
+        static std::array<uint64_t, 2> color_values; // [0] for White, [1] for Black
+        static std::array<uint64_t, 8> castleing_values; // 0/1/2/3 for White castle None/King/Queen/Both side
+        static std::array<uint64_t, 8> enpassant_values; // One for each file
+        // Cuckoo hash tables of every knight, bishop, rook, queen and king action on an empty board,
+        //  by how much they change the hash. The squares are stored as from * 64 + to.
+        static std::array<uint64_t, 8192> cuckoo;
+        static std::array<uint16_t, 8192> cuckoo_squares;
+
+        Zobrist() : hash(0) {}
+
+        static uint64_t piece_value(int square, Skaia::Color color, Skaia::Type type)
+        {
+            return piece_values[color * 384 + square * 6 + (static_cast<int>(type) - 1)];
+        }
+        // The two slots a key may be in
+        static int cuckoo_first(uint64_t key) { return key & 0x1fff; }
+        static int cuckoo_second(uint64_t key) { return (key >> 16) & 0x1fff; }
+        // Finds the action that changes a hash by key, without a capture, promotion or
+        //  change of castling or en passant. Returns false if there isn't one, otherwise
+        //  its squares are put in from and to, though the piece may be moving either way.
+        static bool find_cuckoo(uint64_t key, int& from, int& to)
+        {
+            int slot = cuckoo_first(key);
+            if (cuckoo[slot] != key)
+            {
+                slot = cuckoo_second(key);
+                if (cuckoo[slot] != key) return false;
+            }
+            from = cuckoo_squares[slot] / 64;
+            to = cuckoo_squares[slot] % 64;
+            return true;
+        }
 
-
-
-        Zobrist(uint64_t seed);
         // Call these functions a second time to undo the first
-        void update_piece(const Skaia::Position &pos, const Skaia::Color &color, const Skaia::Type &type);
-        void toggle_color(const Skaia::Color& color);
-        void update_castling(const Skaia::Color& color, int state);
-        void update_enpassant(int file);
-    private:
-        std::mt19937_64 random;
+        void update_piece(int square, Skaia::Color color, Skaia::Type type)
+        {
+            hash ^= piece_value(square, color, type);
+        }
+        void toggle_color(Skaia::Color color) { hash ^= color_values[static_cast<int>(color)]; }
+        void update_castling(Skaia::Color color, int state) { hash ^= castleing_values[color * 4 + state]; }
+        void update_enpassant(int file) { hash ^= enpassant_values[file]; }
 };
-
@@ -4,8 +4,12 @@
 
 #include "SkaiaTest.h"
 
+#include <algorithm>
 #include <atomic>
-#include <thread>
+#include <cctype>
+#include <cstdlib>
+#include <future>
+#include <limits>
 
 
 /// <summary>
@@ -23,25 +27,9 @@ std::string Chess::AI::getName()
 void Chess::AI::start()
 {
     // This is a good place to initialize any variables you add to your AI, or start tracking game objects.
+    search_pool.reset(new Skaia::ThreadPool(std::max(get_setting("threads", 1), 1)));
     // Run the tests!
     SkaiaTest();
-    // Initialize the average_times to somewhat meaningfull values
-    // NOTE: These are intentionaly underestimates, so that, if given the chance, the AI may actually increase it's depth.
-    auto make_time = [&](double time) {
-        return std::chrono::nanoseconds(static_cast<uint64_t>(time * 1e9));
-    };
-    average_time[0] = make_time(0);
-    average_time[1] = make_time(0.01);
-    average_time[2] = make_time(0.5);
-    average_time[3] = make_time(5.0);
-    average_time[4] = make_time(10.0);
-    average_time[5] = make_time(20.0);
-    average_time[6] = make_time(40.0);
-    average_time[7] = make_time(80.0);
-    average_time[8] = make_time(160.0);
-    average_time[9] = make_time(320.0);
-    average_time[10] = make_time(1024.0);
-    std::cout << "avg: " << average_time[1].count() << " and " << average_time[2].count() << std::endl;
 }
 
 /// <summary>
@@ -61,19 +49,87 @@ void Chess::AI::ended(bool won, std::string reason)
 {
     // You can do any cleanup of you AI here, or do custom logging. After this function returns the application will close.
     std::cout << "Waiting for threads to finish" << std::endl;
-    if (!idmm_stop)
+    idmm_stop = true;
+    pondering_stop = true;
+    for (auto& search : pondering) search.wait();
+    std::cout << "Threads finished" << std::endl;
+}
+
+
+std::vector<std::future<Chess::AI::Searched>> Chess::AI::search(const Skaia::State& root, Skaia::Color me,
+        std::atomic<bool>& stop, Skaia::TimeManager* time_manager, int guess)
+{
+    std::vector<std::future<Searched>> searches;
+    // The helpers start from the history table as it is now. It has to be copied
+    //  before the main search starts, which writes to it from a worker thread.
+    HistoryTable helper_history;
+    if (search_pool->size() > 1) helper_history = history_table;
+    // The main search aims each depth at the score of the one before it
+    // It also tells the time manager about every depth, and wakes runTurn once it's done
+    searches.push_back(search_pool->submit([this, root, me, guess, &stop, time_manager] {
+        Skaia::State state_copy = root;
+        Skaia::SearchStack search_stack(state_copy);
+        Searched best{0, Skaia::MMReturn{guess, Skaia::Action(), 0}};
+        for (int d = 1; d < Skaia::SearchStack::max_ply && !stop; ++d)
+        {
+            auto action = Skaia::aspiration_minimax(state_copy, me, d, best.second.heuristic,
+                    history_table, transposition_table, search_stack, stop);
+            if (stop) break;
+            best = Searched{d, action};
+            if (time_manager != nullptr &&
+                    time_manager->depth_finished(action.action, action.states_evaluated)) break;
+        }
+        if (time_manager != nullptr) time_manager->finish();
+        return best;
+    }));
+    // Lazy SMP: helpers run the same iterative deepening on their own copies,
+    //  sharing only the transposition table. Every other one starts a ply deeper,
+    //  so that the workers spread out over the depths and fill the table for each other.
+    // Each one gets its own copy of the snapshot taken above.
+    for (int i = 1; i < search_pool->size(); ++i)
     {
-        idmm_stop = true;
-        idmm_thread.join();
+        searches.push_back(search_pool->submit([this, root, me, i, helper_history, &stop]() mutable {
+            Skaia::State state_copy = root;
+            Skaia::SearchStack search_stack(state_copy);
+            Searched best{0, Skaia::MMReturn{0, Skaia::Action(), 0}};
+            for (int d = 1 + i % 2; d < Skaia::SearchStack::max_ply && !stop; ++d)
+            {
+                auto action = Skaia::interruptable_minimax(state_copy, me, d,
+                        std::numeric_limits<int>::lowest(), std::numeric_limits<int>::max(),
+                        helper_history, transposition_table, search_stack, stop);
+                if (stop) break;
+                best = Searched{d, action};
+            }
+            return best;
+        }));
     }
-    if (!pondering_stop)
+    return searches;
+}
+
+Chess::AI::Searched Chess::AI::deepest(std::vector<std::future<Searched>>& searches, Searched fallback)
+{
+    // The first search is the main one, so it wins ties
+    for (auto& search : searches)
     {
-        pondering_stop = true;
-        pondering_thread.join();
+        auto searched = search.get();
+        if (searched.first > fallback.first)
+        {
+            fallback = searched;
+        }
     }
-    std::cout << "Threads finished" << std::endl;
+    return fallback;
 }
 
+int Chess::AI::get_setting(const std::string& name, int fallback)
+{
+    std::string variable = "SKAIA_";
+    for (char c : name) variable += static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    const char* value = std::getenv(variable.c_str());
+    if (value == nullptr) return fallback;
+    char* end;
+    long number = std::strtol(value, &end, 10);
+    return end != value && *end == '\0' ? static_cast<int>(number) : fallback;
+}
 
 /// <summary>
 /// This is called every time it is this AI.player's turn.
@@ -86,7 +142,6 @@ bool Chess::AI::runTurn()
     // Shorthands so we don't get too verbose
     using std::chrono::nanoseconds;
     using std::chrono::milliseconds;
-    using std::chrono::seconds;
     using std::chrono::duration_cast;
 
     std::cout << "begin" << std::endl; // TODO: Remove
@@ -100,45 +155,28 @@ bool Chess::AI::runTurn()
         std::cout << "Slept for " << slumber.count() << " seconds." << std::endl;
     }
 
-    if (this->game->currentTurn > 1)
+    // Stop pondering, what it found is kept in the transposition table.
+    // Its best action is the reply we expected, and its score (for us) is the first guess at ours.
+    bool pondered = !pondering.empty();
+    Searched expected{0, Skaia::MMReturn{0, Skaia::Action(), 0}};
+    if (pondered)
     {
-        // Wait for the pondering thread to finish
-        std::cout << "joining pondering thread" << std::endl; // TODO: Remove
         pondering_stop = true;
-        pondering_thread.join();
-        std::cout << "joined pondering thread" << std::endl; // TODO: Remove
+        expected = deepest(pondering, expected);
+        pondering.clear();
+        std::cout << "Pondered to depth " << expected.first << " expecting " << expected.second.action << std::endl;
     }
 
     // Keep track of the previous action
-    Skaia::Action previous_action(Skaia::Position(-1, -1), Skaia::Position(-1, -1), Skaia::Pawn);
+    Skaia::Action previous_action;
 
     // Apply previous move to state
     if (this->game->currentTurn > 0)
     {
         Move& move = *(this->game->moves.back());
-        Skaia::Position from(Skaia::rank_to_skaia(move.fromRank), Skaia::file_to_skaia(move.fromFile));
-        Skaia::Position to(Skaia::rank_to_skaia(move.toRank), Skaia::file_to_skaia(move.toFile));
-        Skaia::Type promotion = Skaia::type_to_skaia(move.promotion);
-
-        Skaia::Piece* piece = state.at(from).piece;
-        // Detect double pawn move
-        if (piece->type == Skaia::Pawn && abs(to.rank - from.rank) == 2)
-        {
-            promotion = Skaia::Pawn;
-        }
-        // Detect en-passant
-        if (piece->type == Skaia::Pawn && to.file != from.file && state.at(to).piece == nullptr)
-        {
-            promotion = Skaia::King;
-        }
-        /// Detect castling
-        else if (piece->type == Skaia::King && abs(from.file - to.file) == 2)
-        {
-            promotion = Skaia::King;
-        }
-
-        previous_action = Skaia::Action(from, to, promotion);
+        previous_action = Skaia::action_from_move(state, move);
         state.apply_action(previous_action);
+        if (pondered && previous_action == expected.second.action) std::cout << "Ponder hit" << std::endl;
     }
     state.turn = this->game->currentTurn;
 
@@ -150,172 +188,63 @@ bool Chess::AI::runTurn()
     std::cout << "Turn number: " << this->game->currentTurn << std::endl;
     std::cout << "Time Remaining: " << this->player->timeRemaining << " ns" << std::endl;
 
-    // Find the difference in remaining time between players
-    std::cout << "Difference in player time: " << this->player->timeRemaining - this->player->otherPlayer->timeRemaining << std::endl;
-    auto player_time_difference = duration_cast<milliseconds>(
-            nanoseconds(static_cast<int64_t>(this->player->timeRemaining - this->player->otherPlayer->timeRemaining)));
-    std::cout << "Time to spend: " << player_time_difference.count() << std::endl;
+    // Budget this turn, the game has no increment
+    auto legal_actions = state.generate_actions();
+    Skaia::TimeManager time_manager(genesis, nanoseconds(static_cast<int64_t>(this->player->timeRemaining)),
+            nanoseconds(0), this->game->currentTurn / 2, static_cast<int>(legal_actions.size()));
+    std::cout << "Soft limit: " << duration_cast<milliseconds>(time_manager.soft_limit).count() <<
+        " ms, hard limit: " << duration_cast<milliseconds>(time_manager.hard_limit).count() << " ms" << std::endl;
 
-    // Determine the depth we need to start search at
-    int depth = 4;
-    if (state.turn <= 1) depth = 4;
+    // Entries from previous turns are replaced first, pondering
+    //  already started a new search for this turn
+    if (!pondered) transposition_table.new_search();
 
-    // Try to get result of pondering thread
-    Skaia::MMReturn ret{-1, previous_action, -1};
-    bool found_pondering_result = false;
-    if (state.turn > 1)
-    {
-        // Print out how far the pondering thread searched
-        std::cout << "Pondering thread searched to depth of: " << pondering_depth << std::endl;
-        // Use the result of the pondering thread
-        for (auto &pair : pondering_move)
-        {
-            if (pair.first == previous_action)
-            {
-                ret = pair.second;
-                found_pondering_result = true;
-                depth = pondering_depth - 1;
-                break;
-            }
-        }
-    }
-    if (!found_pondering_result)
-    {
-        // Generate a simple action in case the idmm_thread somehow fails
-        ret = Skaia::minimax(state, (state.turn % 2 ? Skaia::Black : Skaia::White), depth, 3,
-                std::numeric_limits<int>::lowest(), std::numeric_limits<int>::max(), history_table);
-        if (state.turn > 1)
-        {
-            std::cerr << "Failed to find result from pondering thread!" << std::endl;
-        }
-        depth += 1;
-    }
+    // Something to play if not even one depth finishes
+    Skaia::MMReturn ret{expected.second.heuristic, legal_actions[0], 0};
 
-    std::cout << "before thread" << std::endl;
-    // Call minimax in a separate thread
-    std::cout << "1" << std::endl;
+    // Search until the main search is done or the hard limit passes.
+    //  With only one legal action the limits are zero, and that action is played.
     idmm_stop = false;
-    std::cout << "2" << std::endl;
-    idmm_busy.clear();
-    std::cout << "3" << std::endl;
-    idmm_thread = std::thread([&] {
-        Skaia::State state_copy = state;
-        while (!idmm_stop)
-        {
-            std::cout << "4" << std::endl;
-            auto action = Skaia::interruptable_minimax(state_copy,
-                    (state_copy.turn % 2 ? Skaia::Black : Skaia::White),
-                    depth,
-                    3,
-                    std::numeric_limits<int>::lowest(),
-                    std::numeric_limits<int>::max(),
-                    history_table,
-                    idmm_stop);
-            std::cout << "5" << std::endl;
-            while (idmm_busy.test_and_set() && !idmm_stop);
-            std::cout << "6" << std::endl;
-            if (idmm_stop)
-            {
-                idmm_busy.clear();
-                break;
-            }
-            std::cout << "7" << std::endl;
-            ret = action;
-            std::cout << "8" << std::endl;
-            idmm_busy.clear();
-            std::cout << "9" << std::endl;
-            depth += 1;
-        }
-    });
-    std::cout << "after thread" << std::endl;
-
-    // Wait slightly less than our opponent
-    auto time_to_spend = player_time_difference -
-        duration_cast<milliseconds>(std::chrono::steady_clock::now() - genesis);
-    time_to_spend -= milliseconds(300);
-    // But slightly more if we are losing
-    if (ret.heuristic < -1000) time_to_spend += milliseconds(600);
-    // And cap off our min and max time
-    if (time_to_spend < seconds(1)) time_to_spend = seconds(1);
-    if (time_to_spend > seconds(20)) time_to_spend = seconds(20);
-
-    std::cout << "time_to_spend: " << time_to_spend.count() << std::endl;
-    if (time_to_spend.count() > 0)
-    {
-        std::this_thread::sleep_for(milliseconds(time_to_spend));
-    }
+    auto searches = search(state, state.to_move(), idmm_stop, &time_manager, ret.heuristic);
+    time_manager.wait();
     idmm_stop = true;
-    while (idmm_busy.test_and_set());
+    auto searched = deepest(searches, Searched{0, ret});
+    int completed_depth = searched.first;
+    ret = searched.second;
 
     // Check time
     std::chrono::duration<double> duration = duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - genesis);
 
-    std::cout << "Depth: " << (depth - 1) << std::endl;
+    std::cout << "Depth: " << completed_depth << " with " << search_pool->size() << " threads" << std::endl;
+    std::cout << "Branching factor: " << time_manager.branching_factor() << std::endl;
     std::cout << "Took " << duration.count() << " seconds for " << ret.states_evaluated << " states" << std::endl;
     std::cout << "Heuristic " << ret.heuristic << " with action " << ret.action << std::endl;
         
-    // Clean up the history table (check 10% of entries for expiration)
-    std::cout << "History table size: " << history_table.scores.size() << std::endl;
-    std::cout << "Number of buckets: " << history_table.scores.bucket_count() << std::endl;
-    history_table.decay(history_table.scores.size() / 10, state.turn - 20);
-    std::cout << "New History table size: " << history_table.scores.size() << std::endl;
+    // Age the history table so that old scores fade out
+    history_table.decay();
 
     // Make move through framework
     auto move = ret.action;
-    auto from_rank = Skaia::rank_from_skaia(move.from.rank);
-    auto from_file = Skaia::file_from_skaia(move.from.file);
-    auto to_rank = Skaia::rank_from_skaia(move.to.rank);
-    auto to_file = Skaia::file_from_skaia(move.to.file);
+    auto fields = Skaia::move_fields(move);
     for (auto&& piece : this->player->pieces)
     {
-        if (piece->rank == from_rank && piece->file == from_file)
+        if (piece->rank == fields.from_rank && piece->file == fields.from_file)
         {
-            piece->move(to_file, to_rank, Skaia::type_from_skaia(move.promotion));
+            piece->move(fields.to_file, fields.to_rank, fields.promotion);
         }
     }
     // Apply move to state
     state.apply_action(move);
 
-    // Reset resource so that it can be accessed later
-    idmm_busy.clear();
-
     turn_end = std::chrono::steady_clock::now();
-    
-    // Start pondering thread
+
+    // Ponder on the opponent's turn, until runTurn is called again. Every reply
+    //  it looks at warms the transposition table for our next turn. It still
+    //  evaluates for us, heuristic isn't antisymmetric, so scores from a search
+    //  for the opponent wouldn't match the ones our own search stores.
     pondering_stop = false;
-    pondering_thread = std::thread([&] {
-        Skaia::State state_copy = state;
-        pondering_depth = 2;
-        pondering_move.clear();
-        std::cout << "Joining idmm_thread" << std::endl;
-        idmm_thread.join(); // Wait for idmm_thread
-        std::cout << "Joined idmm_thread" << std::endl;
-        while (!pondering_stop)
-        {
-            std::cout << "p1" << std::endl;
-            auto new_pondering_move = Skaia::pondering_minimax(state_copy,
-                    ((state_copy.turn + 1) % 2 ? Skaia::Black : Skaia::White),
-                    pondering_depth,
-                    3,
-                    std::numeric_limits<int>::lowest(),
-                    std::numeric_limits<int>::max(),
-                    history_table,
-                    pondering_stop);
-            std::cout << "p2" << std::endl;
-            while (pondering_busy.test_and_set() && !pondering_stop);
-            std::cout << "p3" << std::endl;
-            if (pondering_stop)
-            {
-                pondering_busy.clear();
-                break;
-            }
-            std::cout << "p4" << std::endl;
-            pondering_move = new_pondering_move;
-            pondering_depth += 1;
-            pondering_busy.clear();
-            std::cout << "p5" << std::endl;
-        }
-    });
+    transposition_table.new_search();
+    pondering = search(state, !state.to_move(), pondering_stop, nullptr, ret.heuristic);
 
     return true; // to signify we are done with our turn.
 }
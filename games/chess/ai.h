@@ -17,11 +17,18 @@
 #include <cstdint>
 #include <atomic>
 #include <thread>
+#include <future>
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
 #include "SkaiaState.h"
+#include "SkaiaMove.h"
 #include "SkaiaMM.h"
+#include "SkaiaThreadPool.h"
+#include "SkaiaTimeManager.h"
 #include "HistoryTable.h"
+#include "TranspositionTable.h"
 
 /// <summary>
 /// This the header file for where you build your AI for the Chess game.
@@ -32,19 +39,21 @@ class Chess::AI : public Joueur::BaseAI
         /// Custom stuffs
         Skaia::State state; // Store the board state between turns
         std::chrono::time_point<std::chrono::steady_clock> turn_end; // Used to measure how long the opponent is taking
-        std::map<int, std::chrono::nanoseconds> average_time; // Holds the average time (in ns) it has taken to traverse down to the given depth
 
-        std::thread idmm_thread;
-        std::atomic<bool> idmm_stop;
-        std::atomic_flag idmm_busy; // Set when a resource is busy
+        std::atomic<bool> idmm_stop{false}; // Tells this turn's searches to return
 
-        std::thread pondering_thread;
-        std::atomic<bool> pondering_stop;
-        std::atomic_flag pondering_busy;
-        std::vector<std::pair<Skaia::Action, Skaia::MMReturn>> pondering_move;
-        int pondering_depth;
+        std::atomic<bool> pondering_stop{false};
+
+        // The deepest depth a search finished and its result, depth 0 if none finished
+        typedef std::pair<int, Skaia::MMReturn> Searched;
+        std::vector<std::future<Searched>> pondering; // Not empty while pondering on the opponent's turn
 
         HistoryTable history_table;
+        TranspositionTable transposition_table{64}; // Size in megabytes
+
+        // Runs every search, made in start() with one worker per thread.
+        //  This is last so that the workers are stopped before anything they use is destroyed.
+        std::unique_ptr<Skaia::ThreadPool> search_pool;
 
         /// <summary>
         /// This is a pointer to the Game object itself, it contains all the information about the current game
@@ -86,6 +95,16 @@ class Chess::AI : public Joueur::BaseAI
         /// </summary>
         /// <returns>Represents if you want to end your turn. True means end your turn, False means to keep your turn going and re-call this function.</returns>
         bool runTurn();
+
+        /// Starts iterative deepening from root on every worker, until stop is set.
+        /// The heuristic, guess and results are for me, whoever is to move in root.
+        /// time_manager may be nullptr, otherwise the main search reports each depth to it and stops when it says so.
+        std::vector<std::future<Searched>> search(const Skaia::State& root, Skaia::Color me, std::atomic<bool>& stop,
+                Skaia::TimeManager* time_manager, int guess);
+        /// Waits for every search and returns the deepest result, or fallback if none went deeper
+        static Searched deepest(std::vector<std::future<Searched>>& searches, Searched fallback);
+        /// Reads a setting from the environment variable SKAIA_<NAME>, or returns fallback if it isn't a number
+        static int get_setting(const std::string& name, int fallback);
 };
 
 #endif
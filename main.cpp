@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <string>
+#include <cstdlib>
 #include <boost/program_options.hpp>
 #include "joueur/client.h"
 #include "joueur/baseGame.h"
@@ -24,6 +25,7 @@ int main(int argc, char* argv[])
         ("password,w", po::value<std::string>()->default_value(""), "the password required for authentication on official servers")
         ("gameSettings", po::value<std::string>()->default_value(""), "Any settings for the game server to force. Must be url parms formatted (key=value&otherKey=otherValue)")
         ("session,r", po::value<std::string>()->default_value("*"), "the requested game session you want to play on the server")
+        ("threads,t", po::value<int>(), "the number of threads the AI may search with, one if not given. Sets SKAIA_THREADS for the AI")
         ("printIO", "(debugging) print IO through the TCP socket to the terminal");
 
     po::positional_options_description p;
@@ -55,6 +57,17 @@ int main(int argc, char* argv[])
     std::string requestedSession = vm["session"].as<std::string>();
     bool printIO = (vm.count("printIO") > 0);
 
+    // Handed to the AI through the environment, so that joueur/ doesn't need to know about it
+    if (vm.count("threads"))
+    {
+        std::string threads = std::to_string(vm["threads"].as<int>());
+#ifdef _WIN32
+        _putenv_s("SKAIA_THREADS", threads.c_str());
+#else
+        setenv("SKAIA_THREADS", threads.c_str(), 1);
+#endif
+    }
+
     Joueur::Client *client = Joueur::Client::getInstance();
 
     bool registered = false;
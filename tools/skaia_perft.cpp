@@ -0,0 +1,109 @@
+// Checks the Skaia move generator against the published perft counts for a
+//  set of standard positions, and reports how many nodes per second it visits.
+//
+// Usage:
+//  skaia_perft [max_depth] [--filter]
+//      Runs every standard position up to max_depth ply (default 4, or its deepest known count).
+//  skaia_perft --divide depth "<fen>" [--filter]
+//      Prints the perft count after each move from the given position.
+// --filter uses State::generate_filtered_actions, to check generate_actions against it.
+//
+// Returns non-zero if any count does not match.
+
+#include "../games/chess/SkaiaPerft.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace Skaia;
+
+namespace
+{
+    struct TestPosition
+    {
+        std::string name;
+        std::string fen;
+        std::vector<uint64_t> counts; // counts[i] is perft(i + 1)
+    };
+
+    // From https://www.chessprogramming.org/Perft_Results
+    const std::vector<TestPosition> positions = {
+        {"start", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+            {20, 400, 8902, 197281, 4865609, 119060324}},
+        {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+            {48, 2039, 97862, 4085603, 193690690}},
+        {"position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+            {14, 191, 2812, 43238, 674624, 11030083}},
+        {"position 4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+            {6, 264, 9467, 422333, 15833292}},
+        {"position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+            {44, 1486, 62379, 2103487, 89941194}},
+        {"position 6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+            {46, 2079, 89890, 3894594, 164075551}},
+    };
+
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int max_depth = 4;
+    bool filtered = false;
+    int divide_depth = 0;
+    std::string divide_fen;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--filter") filtered = true;
+        else if (arg == "--divide" && i + 2 < argc)
+        {
+            divide_depth = std::atoi(argv[++i]);
+            divide_fen = argv[++i];
+        }
+        else max_depth = std::atoi(argv[i]);
+    }
+
+    if (divide_depth > 0)
+    {
+        State state = State::from_fen(divide_fen);
+        uint64_t total = 0;
+        for (auto& count : divide(state, divide_depth, filtered))
+        {
+            std::cout << count.first << ": " << count.second << std::endl;
+            total += count.second;
+        }
+        std::cout << "Total: " << total << std::endl;
+        return 0;
+    }
+
+    bool passed = true;
+    uint64_t total_nodes = 0;
+    double total_time = 0;
+    for (auto& position : positions)
+    {
+        State state = State::from_fen(position.fen);
+        for (int depth = 1; depth <= max_depth && depth <= static_cast<int>(position.counts.size()); ++depth)
+        {
+            auto start = std::chrono::steady_clock::now();
+            uint64_t nodes = perft(state, depth, filtered);
+            double time = seconds_since(start);
+            bool correct = nodes == position.counts[depth - 1];
+            passed = passed && correct;
+            total_nodes += nodes;
+            total_time += time;
+            std::cout << position.name << " depth " << depth << ": " << nodes <<
+                (correct ? " ok" : " FAILED, expected " + std::to_string(position.counts[depth - 1])) <<
+                " (" << time << " s, " << static_cast<uint64_t>(nodes / std::max(time, 1e-9)) << " nodes/s)" << std::endl;
+        }
+    }
+    std::cout << (passed ? "All counts match" : "Some counts do not match") << ", " << total_nodes <<
+        " nodes at " << static_cast<uint64_t>(total_nodes / std::max(total_time, 1e-9)) << " nodes/s" << std::endl;
+    return passed ? 0 : 1;
+}